@@ -0,0 +1,78 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "interntable.h"
+
+intern_table_t *intern_table_new() {
+  intern_table_t *table = calloc(1, sizeof(intern_table_t));
+  table->capacity = 64;
+  table->entries = calloc(table->capacity, sizeof(intern_entry_t));
+  return table;
+}
+
+void intern_table_free(intern_table_t *table) {
+  for (size_t idx = 0; idx < table->capacity; idx++) {
+    free(table->entries[idx].value);
+  }
+  free(table->entries);
+  free(table);
+}
+
+unsigned int intern_hash(const char *value, size_t length) {
+  unsigned int hash = 2166136261u;
+  for (size_t idx = 0; idx < length; idx++) {
+    hash ^= (unsigned char)value[idx];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+void intern_table_grow(intern_table_t *table) {
+  size_t capacity = table->capacity * 2;
+  intern_entry_t *entries = calloc(capacity, sizeof(intern_entry_t));
+
+  for (size_t idx = 0; idx < table->capacity; idx++) {
+    intern_entry_t entry = table->entries[idx];
+    if (entry.value == NULL) {
+      continue;
+    }
+
+    size_t slot = entry.hash & (capacity - 1);
+    while (entries[slot].value != NULL) {
+      slot = (slot + 1) & (capacity - 1);
+    }
+    entries[slot] = entry;
+  }
+
+  free(table->entries);
+  table->entries = entries;
+  table->capacity = capacity;
+}
+
+const char *intern_table_get(intern_table_t *table, const char *value, size_t length) {
+  unsigned int hash = intern_hash(value, length);
+  size_t slot = hash & (table->capacity - 1);
+
+  // Open addressing with linear probing.
+  while (table->entries[slot].value != NULL) {
+    intern_entry_t *entry = &table->entries[slot];
+    if (entry->hash == hash && entry->length == length && memcmp(entry->value, value, length) == 0) {
+      return entry->value;
+    }
+    slot = (slot + 1) & (table->capacity - 1);
+  }
+
+  char *copy = malloc(length + 1);
+  memcpy(copy, value, length);
+  copy[length] = '\0';
+
+  table->entries[slot] = (intern_entry_t){ .value = copy, .length = length, .hash = hash };
+  table->size += 1;
+
+  // Keep the load factor under 3/4.
+  if (table->size * 4 > table->capacity * 3) {
+    intern_table_grow(table);
+  }
+
+  return copy;
+}
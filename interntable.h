@@ -0,0 +1,57 @@
+#ifndef _H_INTERN_TABLE
+#define _H_INTERN_TABLE
+
+#include <stddef.h>
+
+typedef struct {
+  char *value;
+  size_t length;
+  unsigned int hash;
+} intern_entry_t;
+
+typedef struct {
+  size_t size;
+  size_t capacity;
+  intern_entry_t *entries;
+} intern_table_t;
+
+/**
+ * Creates a new empty intern table.
+ *
+ * @return A pointer to a new table.
+ */
+intern_table_t *intern_table_new();
+
+/**
+ * Frees the table together with all strings it holds. Pointers returned by
+ * intern_table_get become invalid.
+ *
+ * @param table: Table to deallocate.
+ */
+void intern_table_free(intern_table_t *table);
+
+/**
+ * Looks up a string in the table, adding a copy of it if it's not there yet.
+ * Equal strings always map to the same pointer, so interned strings can be
+ * compared by pointer. Strings are owned by the table and must not be freed.
+ * The table is not thread-safe.
+ *
+ * @param table: Table to look the string up in.
+ * @param value: String to intern, doesn't have to be null-terminated.
+ * @param length: Length of the string.
+ *
+ * @return Interned null-terminated copy of the string.
+ */
+const char *intern_table_get(intern_table_t *table, const char *value, size_t length);
+
+/**
+ * Hashes a string with FNV-1a.
+ *
+ * @param value: String to hash, doesn't have to be null-terminated.
+ * @param length: Length of the string.
+ *
+ * @return Hash of the string.
+ */
+unsigned int intern_hash(const char *value, size_t length);
+
+#endif
@@ -1,29 +1,41 @@
+// For strtod_l and newlocale on glibc.
+#define _GNU_SOURCE
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include <float.h>
+
+// strtod_l isn't standard, where it's missing the fallback is plain strtod,
+// which follows LC_NUMERIC.
+#if !defined(JSON_NO_STRTOD_L) && (defined(__GLIBC__) || defined(__APPLE__) || defined(__FreeBSD__))
+#define JSON_HAVE_STRTOD_L 1
+#include <locale.h>
+#include <pthread.h>
+#if defined(__APPLE__) || defined(__FreeBSD__)
+#include <xlocale.h>
+#endif
+#endif
 
 #include "json.h"
+#include "jsonpow10.h"
 #include "linkedlist.h"
 #include "genericlist.h"
-
-enum json_parse_error {
-  NOT_SUPPORTED = 1,
-  OUT_OF_BOUNDS = 2,
-  BAD_FORMAT = 3,
-  BAD_SPEC = 4,
-  PROP_NOT_FOUND = 5
-};
+#include "interntable.h"
+#include "utf8.h"
+#include "jsoninternal.h"
 
 /* Internal state. */
 
 enum json_state {
   INIT = 0,
   MIDDLE = 1,
-  EXPONENT = 3,
+  INTEGRAL = 3,
   FRACTION = 4,
   INSTRING = 5,
-  INBOOL = 7,
   ESCAPE = 6,
   ARRAY_NEXT = 8,
   ARRAY_VALUE = 9,
@@ -32,25 +44,11 @@ enum json_state {
   OBJECT_NEXT = 13,
   OBJECT_PROP_NAME = 14,
   OBJECT_PROP_NEXT = 15,
+  EXPONENT = 16,
+  EXPONENT_DIGITS = 17,
   END = 2
 };
 
-/* Internal API */
-
-int is_whitespace(char symbol);
-int is_numeric(char symbol, int allow_minus_sign);
-int is_alpha(char symbol);
-int json_parse_int(const char *input, int *offset, void *target);
-int json_parse_float(const char *input, int *offset, void *target);
-int json_parse_string(const char *input, int *offset, void *target);
-int json_parse_bool(const char *input, int *offset, void *target);
-int json_parse_unknown(const char *input, int *offset);
-int json_parse_value(const char *input, int *offset, void *target, json_descriptor_t descriptor);
-int json_element_size(json_descriptor_t desc);
-void *json_array_element_alloc(json_descriptor_t desc);
-int json_parse_array(const char *input, int *offset, void *target, json_descriptor_t desc);
-int json_parse_object(const char *input, int *offset, void *target, json_descriptor_t desc);
-
 /* Helpers */
 
 int is_whitespace(char symbol) {
@@ -69,19 +67,275 @@ int is_alpha(char symbol) {
   return ((symbol >= 'a' && symbol <= 'z') || (symbol >= 'A' && symbol <= 'Z'));
 }
 
+int is_digit(char symbol) {
+  return (symbol >= '0' && symbol <= '9');
+}
+
+int is_delimiter(char symbol) {
+  return (symbol == ',' || symbol == '}' || symbol == ']' || symbol == '\0' || is_whitespace(symbol));
+}
+
+/** Number conversion */
+
+typedef struct {
+  int negative;
+  const char *integral;
+  int integral_length;
+  const char *fraction;
+  int fraction_length;
+  int exponent;
+} json_number_t;
+
+static const double json_pow10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static const uint64_t json_pow10_u64[] = {
+  1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+  10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+  100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+  100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+  100000000000000000ULL, 1000000000000000000ULL,
+  10000000000000000000ULL
+};
+
+/**
+ * Converts 8 ASCII digits into their numeric value at once (SWAR). The
+ * caller guarantees that all 8 bytes are digits.
+ */
+uint64_t json_convert_8_digits(const char *digits) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  uint64_t value;
+  memcpy(&value, digits, sizeof(value));
+  value -= 0x3030303030303030ULL;
+  value = (value * 10) + (value >> 8);
+  value = (((value & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32)))
+    + (((value >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+  return value;
+#else
+  uint64_t value = 0;
+  for (int idx = 0; idx < 8; idx++) {
+    value = value * 10 + (digits[idx] - '0');
+  }
+  return value;
+#endif
+}
+
+/**
+ * Converts a run of up to 19 ASCII digits into an unsigned integer, eight
+ * digits at a time where possible.
+ */
+uint64_t json_convert_digits(const char *digits, int count) {
+  uint64_t value = 0;
+
+  while (count >= 8) {
+    value = value * 100000000ULL + json_convert_8_digits(digits);
+    digits += 8;
+    count -= 8;
+  }
+
+  while (count > 0) {
+    value = value * 10 + (*digits - '0');
+    digits += 1;
+    count -= 1;
+  }
+
+  return value;
+}
+
+int json_convert_int(const char *digits, int count, int negative, int *target) {
+  // Leading zeros don't contribute to the magnitude.
+  while (count > 1 && *digits == '0') {
+    digits += 1;
+    count -= 1;
+  }
+
+  if (count > 10) {
+    return NUMBER_OVERFLOW;
+  }
+
+  uint64_t value = json_convert_digits(digits, count);
+  uint64_t limit = negative ? (uint64_t)INT_MAX + 1 : (uint64_t)INT_MAX;
+  if (value > limit) {
+    return NUMBER_OVERFLOW;
+  }
+
+  *target = negative ? (int)(0 - value) : (int)value;
+  return 0;
+}
+
+/**
+ * Eisel-Lemire conversion of mantissa * 10^exponent into the closest double,
+ * using a 128-bit approximation of the power of ten. The mantissa must be
+ * non-zero. Returns 0 in the rare cases where the approximation can't decide
+ * the rounding, or the result is subnormal or out of range.
+ */
+int json_convert_eisel_lemire(uint64_t mantissa, int exponent, int negative, double *target) {
+#ifdef __SIZEOF_INT128__
+  if (exponent < JSON_POW10_MIN_EXP10 || exponent > JSON_POW10_MAX_EXP10) {
+    return 0;
+  }
+
+  const uint64_t *power = json_pow10_128[exponent - JSON_POW10_MIN_EXP10];
+  int shift = __builtin_clzll(mantissa);
+  mantissa <<= shift;
+
+  // floor(log2(10) * exponent) + bias, adjusted for the normalization.
+  uint64_t exponent2 = (uint64_t)(((217706 * exponent) >> 16) + 64 + 1023 - shift);
+
+  unsigned __int128 product = (unsigned __int128)mantissa * power[0];
+  uint64_t high = product >> 64, low = (uint64_t)product;
+
+  if ((high & 0x1FF) == 0x1FF && low + mantissa < mantissa) {
+    // The truncated lower half of the power may carry into the result.
+    unsigned __int128 wide = (unsigned __int128)mantissa * power[1];
+    uint64_t wide_high = wide >> 64, wide_low = (uint64_t)wide;
+    uint64_t merged_high = high, merged_low = low + wide_high;
+
+    if (merged_low < low) {
+      merged_high += 1;
+    }
+    if ((merged_high & 0x1FF) == 0x1FF && merged_low + 1 == 0 && wide_low + mantissa < mantissa) {
+      return 0;
+    }
+    high = merged_high;
+    low = merged_low;
+  }
+
+  // Keep 54 bits, one more than needed for rounding.
+  uint64_t top = high >> 63;
+  uint64_t result = high >> (top + 9);
+  exponent2 -= 1 ^ top;
+
+  if (low == 0 && (high & 0x1FF) == 0 && (result & 3) == 1) {
+    // Exactly halfway between two doubles.
+    return 0;
+  }
+
+  result += result & 1;
+  result >>= 1;
+  if (result >> 53 > 0) {
+    result >>= 1;
+    exponent2 += 1;
+  }
+
+  if (exponent2 - 1 >= 0x7FF - 1) {
+    return 0;
+  }
+
+  uint64_t bits = (exponent2 << 52) | (result & 0x000FFFFFFFFFFFFFULL);
+  if (negative) {
+    bits |= 0x8000000000000000ULL;
+  }
+  memcpy(target, &bits, sizeof(double));
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+#if defined(JSON_HAVE_STRTOD_L)
+static locale_t json_c_locale;
+static pthread_once_t json_c_locale_once = PTHREAD_ONCE_INIT;
+
+void json_c_locale_init(void) {
+  json_c_locale = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+}
+#endif
+
+/**
+ * Converts a scanned number into a double. Numbers with at most 19
+ * significant digits are handled without strtod: small exponents with
+ * Clinger's fast path, where the result is a product or quotient of two
+ * exact doubles, and the rest with Eisel-Lemire. Longer numbers and the few
+ * cases Eisel-Lemire can't round go to strtod_l in the C locale, so the
+ * result doesn't depend on LC_NUMERIC, or to strtod where there's no
+ * strtod_l.
+ */
+double json_convert_float(json_number_t *number, const char *text, int text_length) {
+  const char *digits = number->integral;
+  int integral_length = number->integral_length, fraction_length = number->fraction_length;
+  int leading_zeros = 0;
+
+  while (leading_zeros < integral_length && digits[leading_zeros] == '0') {
+    leading_zeros += 1;
+  }
+  if (leading_zeros == integral_length) {
+    while (leading_zeros - integral_length < fraction_length
+        && number->fraction[leading_zeros - integral_length] == '0') {
+      leading_zeros += 1;
+    }
+  }
+
+  int significant = integral_length + fraction_length - leading_zeros;
+  if (significant == 0) {
+    return number->negative ? -0.0 : 0.0;
+  }
+
+  if (significant <= 19) {
+    uint64_t mantissa = 0;
+    if (leading_zeros < integral_length) {
+      mantissa = json_convert_digits(digits + leading_zeros, integral_length - leading_zeros) * json_pow10_u64[fraction_length]
+        + json_convert_digits(number->fraction, fraction_length);
+    } else {
+      mantissa = json_convert_digits(number->fraction + leading_zeros - integral_length, significant);
+    }
+    int exponent = number->exponent - fraction_length;
+    double value = 0;
+
+#if FLT_EVAL_METHOD == 0
+    if (mantissa <= (1ULL << 53)) {
+      value = (double)mantissa;
+
+      if (exponent >= -22 && exponent <= 22) {
+        value = exponent < 0 ? value / json_pow10[-exponent] : value * json_pow10[exponent];
+        return number->negative ? -value : value;
+      } else if (exponent > 22 && exponent <= 22 + 15
+          && mantissa <= (1ULL << 53) / json_pow10_u64[exponent - 22]) {
+        // Shift some of the exponent into the (still exact) mantissa.
+        value = (double)(mantissa * json_pow10_u64[exponent - 22]) * json_pow10[22];
+        return number->negative ? -value : value;
+      }
+    }
+#endif
+
+    if (json_convert_eisel_lemire(mantissa, exponent, number->negative, &value)) {
+      return value;
+    }
+  }
+
+  char local[64], *buffer = local;
+  if (text_length >= (int)sizeof(local)) {
+    buffer = malloc(text_length + 1);
+  }
+  memcpy(buffer, text, text_length);
+  buffer[text_length] = '\0';
+
+#if defined(JSON_HAVE_STRTOD_L)
+  pthread_once(&json_c_locale_once, json_c_locale_init);
+  double value = strtod_l(buffer, NULL, json_c_locale);
+#else
+  double value = strtod(buffer, NULL);
+#endif
+
+  if (buffer != local) {
+    free(buffer);
+  }
+  return value;
+}
+
 /** JSON implementation */
 
 int json_parse_int(const char *input, int *offset, void *target) {
-  int length = strlen(input) - (*offset);
-  if (length <= 0) {
+  if (input[*offset] == '\0') {
     return OUT_OF_BOUNDS;
   }
 
-  char *buffer = calloc(strlen(input), sizeof(char));
-  int state = INIT, error = 0;
+  int state = INIT, error = 0, negative = 0;
+  int index = *offset, digits = 0;
 
-  int index = *offset, buffer_offset = 0;
-  while (index < strlen(input) && error == 0 && state != END) {
+  while (error == 0 && state != END) {
     char symbol = input[index];
 
     switch (state) {
@@ -89,97 +343,121 @@ int json_parse_int(const char *input, int *offset, void *target) {
       if (is_whitespace(symbol)) {
         // Skip whitespace symbols.
         index += 1;
-      } else if ((symbol >= '0' && symbol <= '9') || symbol == '-') {
-        buffer[buffer_offset] = symbol;
-        buffer_offset += 1;
+      } else if (is_digit(symbol) || symbol == '-') {
+        negative = (symbol == '-');
+        index += negative;
+        digits = index;
         state = MIDDLE;
-        index += 1;
       } else {
         error = BAD_FORMAT;
       }
       break;
     case MIDDLE:
-      if (symbol >= '0' && symbol <= '9') {
-        buffer[buffer_offset] = symbol;
-        buffer_offset += 1;
+      while (is_digit(input[index])) {
         index += 1;
-      } else if (symbol == ',' || symbol == '}' || symbol == ']' || is_whitespace(symbol)) {
-        state = END;
-      } else {
+      }
+      if (index == digits || !is_delimiter(input[index])) {
         error = BAD_FORMAT;
+      } else {
+        state = END;
       }
       break;
     }
   }
 
-  if (error == 0) {
-    if (target != NULL) {
-      buffer[buffer_offset+1] = '\0';
-      int *t_int = target;
-      *t_int = atoi(buffer);
-    }
+  if (error == 0 && target != NULL) {
+    error = json_convert_int(input + digits, index - digits, negative, target);
+  }
 
+  if (error == 0) {
     // Advance the offset to the last unparsed symbol.
     *offset = index;
   }
 
-  free(buffer);
   return error;
 }
 
 int json_parse_float(const char *input, int *offset, void *target) {
-  int length = strlen(input) - (*offset);
-  if (length <= 0) {
+  if (input[*offset] == '\0') {
     return OUT_OF_BOUNDS;
   }
 
-  char *buffer = calloc(strlen(input), sizeof(char));
+  json_number_t number = { 0 };
   int state = INIT, error = 0;
+  int index = *offset, start = index, exponent_negative = 0;
 
-  int index = *offset, buffer_offset = 0;
-  while (index < strlen(input) && error == 0 && state != END) {
+  while (error == 0 && state != END) {
     char symbol = input[index];
+
     switch (state) {
     case INIT:
       if (is_whitespace(symbol)) {
         // Skip whitespace symbols.
         index += 1;
-      } else if ((symbol >= '0' && symbol <= '9') || symbol == '-') {
-        buffer[buffer_offset] = symbol;
-        buffer_offset += 1;
-        state = EXPONENT;
+      } else if (is_digit(symbol) || symbol == '-' || symbol == '.') {
+        start = index;
+        number.negative = (symbol == '-');
+        index += number.negative;
+        number.integral = input + index;
+        state = INTEGRAL;
+      } else {
+        error = BAD_FORMAT;
+      }
+      break;
+    case INTEGRAL:
+      while (is_digit(input[index])) {
         index += 1;
-      } else if (symbol == '.') {
-        buffer[buffer_offset] = symbol;
-        buffer_offset += 1;
+      }
+      number.integral_length = input + index - number.integral;
+      symbol = input[index];
+      if (symbol == '.') {
+        index += 1;
+        number.fraction = input + index;
         state = FRACTION;
+      } else if (symbol == 'e' || symbol == 'E') {
         index += 1;
+        state = EXPONENT;
+      } else if (is_delimiter(symbol)) {
+        state = END;
       } else {
         error = BAD_FORMAT;
       }
       break;
-    case EXPONENT:
-      if (symbol >= '0' && symbol <= '9') {
-        buffer[buffer_offset] = symbol;
-        buffer_offset += 1;
+    case FRACTION:
+      while (is_digit(input[index])) {
         index += 1;
-      } else if (symbol == '.') {
-        buffer[buffer_offset] = symbol;
-        buffer_offset += 1;
-        state = FRACTION;
+      }
+      number.fraction_length = input + index - number.fraction;
+      symbol = input[index];
+      if (symbol == 'e' || symbol == 'E') {
         index += 1;
-      } else if (symbol == ',' || symbol == '}' ||  symbol == ']' || is_whitespace(symbol)) {
+        state = EXPONENT;
+      } else if (is_delimiter(symbol)) {
         state = END;
       } else {
         error = BAD_FORMAT;
       }
       break;
-    case FRACTION:
-      if (symbol >= '0' && symbol <= '9') {
-        buffer[buffer_offset] = symbol;
-        buffer_offset += 1;
+    case EXPONENT:
+      if (symbol == '-' || symbol == '+') {
+        exponent_negative = (symbol == '-');
+        index += 1;
+      }
+      if (!is_digit(input[index])) {
+        error = BAD_FORMAT;
+      } else {
+        state = EXPONENT_DIGITS;
+      }
+      break;
+    case EXPONENT_DIGITS:
+      while (is_digit(input[index])) {
+        // Clamp absurd exponents, the result is zero or infinity anyway.
+        if (number.exponent < 100000) {
+          number.exponent = number.exponent * 10 + (input[index] - '0');
+        }
         index += 1;
-      } else if (symbol == ',' || symbol == '}' || symbol == ']' || is_whitespace(symbol)) {
+      }
+      if (is_delimiter(input[index])) {
         state = END;
       } else {
         error = BAD_FORMAT;
@@ -188,57 +466,115 @@ int json_parse_float(const char *input, int *offset, void *target) {
     }
   }
 
+  if (error == 0 && number.integral_length + number.fraction_length == 0) {
+    error = BAD_FORMAT;
+  }
+
   if (error == 0) {
     if (target != NULL) {
-      buffer[buffer_offset] = '\0';
+      if (exponent_negative) {
+        number.exponent = -number.exponent;
+      }
       double *t_double = target;
-      *t_double = strtod(buffer, NULL);
+      *t_double = json_convert_float(&number, input + start, index - start);
     }
 
     // Advance the offset to the last unparsed symbol.
     *offset = index;
   }
 
-  free(buffer);
   return error;
 }
 
-int json_parse_string(const char *input, int *offset, void *target) {
-  int length = strlen(input) - (*offset);
-  if (length <= 0) {
-    return OUT_OF_BOUNDS;
+int json_string_extent(const char *input, int index, int *start, int *end, int *escaped) {
+  while (is_whitespace(input[index])) {
+    index += 1;
   }
 
-  char *buffer = calloc(strlen(input), sizeof(char));
-  int state = INIT, error = 0;
+  if (input[index] != '"') {
+    return BAD_FORMAT;
+  }
+  index += 1;
+  *start = index;
+  *escaped = 0;
+
+  while (input[index] != '"') {
+    if (input[index] == '\0') {
+      return BAD_FORMAT;
+    } else if (input[index] == '\\') {
+      *escaped = 1;
+      if (input[index + 1] == '\0') {
+        return BAD_FORMAT;
+      }
+      index += 2;
+    } else {
+      index += 1;
+    }
+  }
+
+  *end = index;
+  return 0;
+}
+
+int json_hex_value(const char *input, int index, int end) {
+  int value = 0;
+
+  if (index + 4 > end) {
+    return -1;
+  }
 
-  int index = *offset, buffer_offset = 0;
-  while (index < strlen(input) && error == 0 && state != END) {
+  for (int idx = index; idx < index + 4; idx++) {
+    char symbol = input[idx];
+    value <<= 4;
+    if (is_digit(symbol)) {
+      value |= symbol - '0';
+    } else if (symbol >= 'a' && symbol <= 'f') {
+      value |= symbol - 'a' + 10;
+    } else if (symbol >= 'A' && symbol <= 'F') {
+      value |= symbol - 'A' + 10;
+    } else {
+      return -1;
+    }
+  }
+
+  return value;
+}
+
+int json_utf8_encode(unsigned int code, char *buffer) {
+  if (code < 0x80) {
+    buffer[0] = code;
+    return 1;
+  } else if (code < 0x800) {
+    buffer[0] = 0xc0 | (code >> 6);
+    buffer[1] = 0x80 | (code & 0x3f);
+    return 2;
+  } else if (code < 0x10000) {
+    buffer[0] = 0xe0 | (code >> 12);
+    buffer[1] = 0x80 | ((code >> 6) & 0x3f);
+    buffer[2] = 0x80 | (code & 0x3f);
+    return 3;
+  } else {
+    buffer[0] = 0xf0 | (code >> 18);
+    buffer[1] = 0x80 | ((code >> 12) & 0x3f);
+    buffer[2] = 0x80 | ((code >> 6) & 0x3f);
+    buffer[3] = 0x80 | (code & 0x3f);
+    return 4;
+  }
+}
+
+int json_string_decode(const char *input, int start, int end, char *buffer) {
+  int state = INSTRING, buffer_offset = 0;
+
+  for (int index = start; index < end; index++) {
     char symbol = input[index];
 
     switch (state) {
-    case INIT:
-      if (is_whitespace(symbol)) {
-        // Skip whitespace symbols.
-        index += 1;
-      } else if (symbol == '"') {
-        index += 1;
-        state = INSTRING;
-      } else {
-        error = BAD_FORMAT;
-      }
-      break;
     case INSTRING:
       if (symbol == '\\') {
-        index += 1;
         state = ESCAPE;
-      } else if (symbol != '"') {
+      } else {
         buffer[buffer_offset] = symbol;
         buffer_offset += 1;
-        index += 1;
-      } else {
-        index += 1;
-        state = END;
       }
       break;
     case ESCAPE:
@@ -248,158 +584,311 @@ int json_parse_string(const char *input, int *offset, void *target) {
         buffer[buffer_offset] = '\t';
       } else if (symbol == 'r') {
         buffer[buffer_offset] = '\r';
+      } else if (symbol == 'b') {
+        buffer[buffer_offset] = '\b';
+      } else if (symbol == 'f') {
+        buffer[buffer_offset] = '\f';
+      } else if (symbol == 'u') {
+        int code = json_hex_value(input, index + 1, end);
+        index += 4;
+
+        if (code >= 0xd800 && code <= 0xdbff) {
+          // High surrogate, has to be followed by an escaped low one.
+          int low = -1;
+          if (index + 2 < end && input[index + 1] == '\\' && input[index + 2] == 'u') {
+            low = json_hex_value(input, index + 3, end);
+            index += 6;
+          }
+          if (low < 0xdc00 || low > 0xdfff) {
+            return -1;
+          }
+          code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+        } else if (code >= 0xdc00 && code <= 0xdfff) {
+          code = -1;
+        }
+
+        // U+0000 would cut the decoded string short.
+        if (code <= 0) {
+          return -1;
+        }
+        // Every other branch writes a single byte.
+        buffer_offset += json_utf8_encode(code, buffer + buffer_offset) - 1;
       } else {
         buffer[buffer_offset] = symbol;
       }
       buffer_offset += 1;
       state = INSTRING;
-      index += 1;
       break;
     }
   }
 
-  if (state != END) {
-    error = BAD_FORMAT;
-  }
-
-  if (error == 0) {
-    if (target != NULL) {
-      buffer[buffer_offset] = '\0';
-      char **string_t = target;
-      *string_t = buffer;
-    }
-
-    // Advance the offset to the last unparsed symbol.
-    *offset = index;
-  }
-
-  return error;
+  return buffer_offset;
 }
 
-int json_parse_bool(const char *input, int *offset, void *target) {
-  int length = strlen(input) - (*offset);
-  if (length <= 0) {
+int json_parse_string(const char *input, int *offset, void *target) {
+  if (input[*offset] == '\0') {
     return OUT_OF_BOUNDS;
   }
 
-  char *buffer = calloc(strlen(input), sizeof(char));
-  int state = INIT, error = 0;
+  int start = 0, end = 0, escaped = 0;
+  int error = json_string_extent(input, *offset, &start, &end, &escaped);
 
-  int index = *offset, buffer_offset = 0;
-  while (index < strlen(input) && error == 0 && state != END) {
-    char symbol = input[index];
-    switch (state) {
-    case INIT:
-      if (is_whitespace(symbol)) {
-        // Skip whitespace symbols.
-        index += 1;
-      } else if ((symbol >= 'a' && symbol <= 'z') || (symbol >= 'A' && symbol <= 'Z')) {
-        buffer[buffer_offset] = symbol;
-        buffer_offset += 1;
-        state = INBOOL;
-        index += 1;
+  if (error == 0) {
+    if (target != NULL) {
+      char *buffer = malloc(end - start + 1);
+      int length = end - start;
+
+      if (escaped) {
+        length = json_string_decode(input, start, end, buffer);
       } else {
-        error = BAD_FORMAT;
+        memcpy(buffer, input + start, length);
       }
-      break;
-    case INBOOL:
-      if ((symbol >= 'a' && symbol <= 'z') || (symbol >= 'A' && symbol <= 'Z')) {
-        buffer[buffer_offset] = symbol;
-        buffer_offset += 1;
-        index += 1;
-      } else if (symbol == ',' || symbol == '}' || symbol == ']' || is_whitespace(symbol)) {
-        state = END;
-      } else {
+
+      if (length < 0) {
+        free(buffer);
         error = BAD_FORMAT;
+      } else {
+        buffer[length] = '\0';
+        char **string_t = target;
+        *string_t = buffer;
       }
-      break;
     }
   }
 
   if (error == 0) {
-    buffer[buffer_offset] = '\0';
-    int *t_bool = target;
-    if (strcmp("true", buffer) == 0) {
-      if (target != NULL) {
-        *t_bool = 1;
-      }
-    } else if (strcmp("false", buffer) == 0) {
-      if (target != NULL) {
-        *t_bool = 0;
-      }
-    } else {
-       error = BAD_FORMAT;
-    }
-
     // Advance the offset to the last unparsed symbol.
-    *offset = index;
+    *offset = end + 1;
   }
 
-  free(buffer);
   return error;
 }
 
-int json_parse_unknown(const char *input, int *offset) {
-  int length = strlen(input) - (*offset);
-  if (length <= 0) {
+int json_parse_string_interned(const char *input, int *offset, void *target, intern_table_t *table) {
+  if (input[*offset] == '\0') {
     return OUT_OF_BOUNDS;
   }
 
-  char *buffer = calloc(strlen(input), sizeof(char));
-  int state = INIT, error = 0;
+  if (table == NULL) {
+    return BAD_SPEC;
+  }
 
-  int index = *offset, buffer_offset = 0;
-  while (index < strlen(input) && error == 0 && state != END) {
-    char symbol = input[index];
+  int start = 0, end = 0, escaped = 0;
+  int error = json_string_extent(input, *offset, &start, &end, &escaped);
 
-    switch (state) {
-    case INIT:
-      if (is_whitespace(symbol)) {
-        // Skip whitespace symbols.
-        index += 1;
-      } else if (symbol == '{') {
-        json_descriptor_t desc = {
-          .type = OBJECT,
-          .descriptor = &(json_object_descriptor_t){
-            NULL, NULL, 0, 0, NULL
-          }
-        };
-        error = json_parse_object(input, &index, NULL, desc);
-        state = END;
-      } else if (symbol == '[') {
-        json_descriptor_t desc = {
-          .type = ARRAY,
-          .descriptor = &(json_descriptor_t){
-            .type = UNKNOWN
-          }
-        };
-        error = json_parse_array(input, &index, NULL, desc);
-        state = END;
-      } else if (symbol == '"') {
-        error = json_parse_string(input, &index, NULL);
-        state = END;
-      } else if (is_numeric(symbol, 1)) {
-        error = json_parse_float(input, &index, NULL);
-        state = END;
-      } else if (is_alpha(symbol)) {
-        error = json_parse_bool(input, &index, NULL);
-        state = END;
+  if (error == 0) {
+    if (target != NULL) {
+      const char **string_t = target;
+
+      if (escaped) {
+        char local[256], *buffer = local;
+        if (end - start >= (int)sizeof(local)) {
+          buffer = malloc(end - start + 1);
+        }
+
+        int length = json_string_decode(input, start, end, buffer);
+        if (length < 0) {
+          error = BAD_FORMAT;
+        } else {
+          *string_t = intern_table_get(table, buffer, length);
+        }
+
+        if (buffer != local) {
+          free(buffer);
+        }
       } else {
-        error = BAD_FORMAT;
+        *string_t = intern_table_get(table, input + start, end - start);
       }
-      break;
     }
   }
 
   if (error == 0) {
-    *offset = index;
+    // Advance the offset to the last unparsed symbol.
+    *offset = end + 1;
   }
 
   return error;
 }
 
-int json_parse_value(const char *input, int *offset, void *target, json_descriptor_t descriptor) {
-  int error = 0;
+int json_enum_indexed(json_enum_descriptor_t *enum_desc) {
+  // The index needs an empty slot to end every probe.
+  return enum_desc->index != NULL && enum_desc->index_size > (size_t)enum_desc->num_values;
+}
+
+void json_enum_prepare(json_enum_descriptor_t *enum_desc) {
+  int indexed = json_enum_indexed(enum_desc);
+  if (indexed) {
+    memset(enum_desc->index, 0, enum_desc->index_size * sizeof(int));
+  }
+
+  for (int idx = 0; idx < enum_desc->num_values; idx++) {
+    json_enum_value_t *value = &enum_desc->values[idx];
+    value->length = strlen(value->name);
+    value->hash = intern_hash(value->name, value->length);
+
+    if (indexed) {
+      // Open addressing with linear probing, the first of duplicate names
+      // wins.
+      size_t slot = value->hash % enum_desc->index_size;
+      while (enum_desc->index[slot] != 0) {
+        slot = (slot + 1) % enum_desc->index_size;
+      }
+      enum_desc->index[slot] = idx + 1;
+    }
+  }
+  enum_desc->prepared = 1;
+}
+
+int json_enum_lookup(json_enum_descriptor_t *enum_desc, const char *name, size_t length, int *target) {
+  if (!enum_desc->prepared) {
+    json_enum_prepare(enum_desc);
+  }
+
+  unsigned int hash = intern_hash(name, length);
+
+  if (json_enum_indexed(enum_desc)) {
+    size_t slot = hash % enum_desc->index_size;
+    while (enum_desc->index[slot] != 0) {
+      json_enum_value_t *value = &enum_desc->values[enum_desc->index[slot] - 1];
+      if (value->hash == hash && value->length == length && memcmp(value->name, name, length) == 0) {
+        *target = value->value;
+        return 0;
+      }
+      slot = (slot + 1) % enum_desc->index_size;
+    }
+    return VALUE_NOT_FOUND;
+  }
+
+  for (int idx = 0; idx < enum_desc->num_values; idx++) {
+    json_enum_value_t *value = &enum_desc->values[idx];
+    if (value->hash == hash && value->length == length && memcmp(value->name, name, length) == 0) {
+      *target = value->value;
+      return 0;
+    }
+  }
+
+  return VALUE_NOT_FOUND;
+}
+
+int json_parse_enum(const char *input, int *offset, void *target, json_enum_descriptor_t *enum_desc) {
+  if (input[*offset] == '\0') {
+    return OUT_OF_BOUNDS;
+  }
+
+  if (enum_desc == NULL) {
+    return BAD_SPEC;
+  }
+
+  int start = 0, end = 0, escaped = 0;
+  int error = json_string_extent(input, *offset, &start, &end, &escaped);
+
+  if (error == 0 && target != NULL) {
+    if (escaped) {
+      // Decoding never makes a string longer, and anything that doesn't fit
+      // is longer than any sensible enum name.
+      char local[256];
+      if (end - start >= (int)sizeof(local)) {
+        error = VALUE_NOT_FOUND;
+      } else {
+        int length = json_string_decode(input, start, end, local);
+        error = length < 0 ? BAD_FORMAT : json_enum_lookup(enum_desc, local, length, target);
+      }
+    } else {
+      error = json_enum_lookup(enum_desc, input + start, end - start, target);
+    }
+  }
+
+  if (error == 0) {
+    // Advance the offset to the last unparsed symbol.
+    *offset = end + 1;
+  }
+
+  return error;
+}
+
+int json_parse_bool(const char *input, int *offset, void *target) {
+  if (input[*offset] == '\0') {
+    return OUT_OF_BOUNDS;
+  }
+
+  int index = *offset, value = 0;
+  while (is_whitespace(input[index])) {
+    index += 1;
+  }
+
+  if (strncmp(input + index, "true", 4) == 0) {
+    value = 1;
+    index += 4;
+  } else if (strncmp(input + index, "false", 5) == 0) {
+    index += 5;
+  } else {
+    return BAD_FORMAT;
+  }
+
+  if (!is_delimiter(input[index])) {
+    return BAD_FORMAT;
+  }
+
+  if (target != NULL) {
+    *(int *)target = value;
+  }
+
+  // Advance the offset to the last unparsed symbol.
+  *offset = index;
+  return 0;
+}
+
+/**
+ * Skips over a value without allocating anything. Only strings and nesting
+ * are tracked, so this is a structural skip rather than a validator.
+ */
+int json_skip_value(const char *input, int *offset) {
+  if (input[*offset] == '\0') {
+    return OUT_OF_BOUNDS;
+  }
+
+  int index = *offset, depth = 0, start = 0, end = 0, escaped = 0, error = 0;
+
+  while (is_whitespace(input[index])) {
+    index += 1;
+  }
+
+  do {
+    char symbol = input[index];
+
+    if (symbol == '"') {
+      error = json_string_extent(input, index, &start, &end, &escaped);
+      index = end + 1;
+    } else if (symbol == '{' || symbol == '[') {
+      depth += 1;
+      index += 1;
+    } else if ((symbol == '}' || symbol == ']') && depth > 0) {
+      depth -= 1;
+      index += 1;
+    } else if (depth > 0 && symbol != '\0') {
+      index += 1;
+    } else if (!is_delimiter(symbol)) {
+      // Scalar at the top level: consume it up to the next delimiter.
+      while (!is_delimiter(input[index])) {
+        index += 1;
+      }
+    } else {
+      error = BAD_FORMAT;
+    }
+  } while (error == 0 && depth > 0);
+
+  if (error == 0) {
+    *offset = index;
+  }
+
+  return error;
+}
+
+int json_parse_unknown(const char *input, int *offset) {
+  return json_skip_value(input, offset);
+}
+
+int json_parse_value(const char *input, int *offset, void *target, json_descriptor_t descriptor) {
+  int error = 0;
 
   switch (descriptor.type) {
   case INT:
@@ -411,6 +900,12 @@ int json_parse_value(const char *input, int *offset, void *target, json_descript
   case STRING:
     error = json_parse_string(input, offset, target);
     break;
+  case STRING_INTERNED:
+    error = json_parse_string_interned(input, offset, target, descriptor.descriptor);
+    break;
+  case ENUM:
+    error = json_parse_enum(input, offset, target, descriptor.descriptor);
+    break;
   case BOOL:
     error = json_parse_bool(input, offset, target);
     break;
@@ -420,6 +915,9 @@ int json_parse_value(const char *input, int *offset, void *target, json_descript
   case OBJECT:
     error = json_parse_object(input, offset, target, descriptor);
     break;
+  case COLUMNS:
+    error = json_parse_columns(input, offset, target, descriptor);
+    break;
   case UNKNOWN:
     error = json_parse_unknown(input, offset);
     break;
@@ -435,16 +933,20 @@ int json_element_size(json_descriptor_t desc) {
   switch (desc.type) {
   case BOOL:
   case INT:
+  case ENUM:
     return sizeof(int);
   case FLOAT:
     return sizeof(double);
   case STRING:
+  case STRING_INTERNED:
     return sizeof(char *);
   case ARRAY:
     return sizeof(list_t);
   case OBJECT:
     obj_desc = desc.descriptor;
     return obj_desc->size;
+  case COLUMNS:
+    return json_element_size(*(json_descriptor_t *)desc.descriptor);
   }
 }
 
@@ -456,9 +958,95 @@ void *json_array_element_alloc(json_descriptor_t desc) {
   return calloc(1, json_element_size(desc));
 }
 
+/**
+ * Fast path for arrays of numbers: no per-element dispatch, allocation or
+ * list node, values are converted straight into the output buffer.
+ */
+int json_parse_number_array(const char *input, int *offset, void *target, json_descriptor_t *element_desc) {
+  int index = *offset, error = 0, size = 0, capacity = 1;
+  int element_size = json_element_size(*element_desc);
+
+  while (is_whitespace(input[index])) {
+    index += 1;
+  }
+  if (input[index] != '[') {
+    return BAD_FORMAT;
+  }
+  index += 1;
+
+  // Numbers can't contain brackets, so the first ']' closes the array and
+  // the commas before it give the exact number of elements.
+  const char *symbol = input + index;
+  while (*symbol != ']' && *symbol != '\0') {
+    capacity += (*symbol == ',');
+    symbol += 1;
+  }
+  if (*symbol != ']') {
+    return BAD_FORMAT;
+  }
+
+  void *array = NULL;
+  if (target != NULL) {
+    array = malloc(capacity * element_size);
+  }
+
+  while (error == 0) {
+    while (is_whitespace(input[index])) {
+      index += 1;
+    }
+    if (input[index] == ']' && size == 0) {
+      index += 1;
+      break;
+    }
+    if (size == capacity) {
+      error = BAD_FORMAT;
+      break;
+    }
+
+    void *elem_target = array == NULL ? NULL : array + size * element_size;
+    if (element_desc->type == INT) {
+      error = json_parse_int(input, &index, elem_target);
+    } else {
+      error = json_parse_float(input, &index, elem_target);
+    }
+    if (error != 0) {
+      break;
+    }
+    size += 1;
+
+    while (is_whitespace(input[index])) {
+      index += 1;
+    }
+    if (input[index] == ',') {
+      index += 1;
+    } else if (input[index] == ']') {
+      index += 1;
+      break;
+    } else {
+      error = BAD_FORMAT;
+    }
+  }
+
+  if (error == 0 && target != NULL) {
+    list_t *target_list = target;
+    target_list->size = size;
+    target_list->items = size > 0 ? array : NULL;
+    if (size == 0) {
+      free(array);
+    }
+  } else {
+    free(array);
+  }
+
+  if (error == 0) {
+    *offset = index;
+  }
+
+  return error;
+}
+
 int json_parse_array(const char *input, int *offset, void *target, json_descriptor_t desc) {
-  int length = strlen(input) - (*offset);
-  if (length <= 0) {
+  if (input[*offset] == '\0') {
     return OUT_OF_BOUNDS;
   }
 
@@ -467,11 +1055,15 @@ int json_parse_array(const char *input, int *offset, void *target, json_descript
     return BAD_FORMAT;
   }
 
-  int state = INIT, error = 0, index = *offset;
+  if (element_desc->type == INT || element_desc->type == FLOAT) {
+    return json_parse_number_array(input, offset, target, element_desc);
+  }
+
+  int state = INIT, error = 0, index = *offset, num_values = 0;
   linked_list_t *list = linked_list_new();
   void *elem_target = NULL;
 
-  while (index < strlen(input) && error == 0 && state != END) {
+  while (input[index] != '\0' && error == 0 && state != END) {
     char symbol = input[index];
 
     switch (state) {
@@ -486,15 +1078,36 @@ int json_parse_array(const char *input, int *offset, void *target, json_descript
       index += 1;
       break;
     case ARRAY_VALUE:
-      elem_target = json_array_element_alloc(desc);
-      error = json_parse_value(input, &index, elem_target, *element_desc);
-      if (error == 0) {
+      if (is_whitespace(symbol)) {
+        // Skip whitespace symbols.
+        index += 1;
+        break;
+      } else if (symbol == ']' && num_values == 0) {
+        // Empty array.
+        index += 1;
+        state = END;
+        break;
+      }
+
+      elem_target = json_array_element_alloc(*element_desc);
+      error = json_parse_element(input, &index, elem_target, *element_desc);
+      num_values += 1;
+      if (error == FILTERED_OUT) {
+        // Filters are checked before anything is parsed into the element.
+        free(elem_target);
+        error = 0;
+        state = ARRAY_NEXT;
+      } else if (error == 0) {
         if (element_desc->type == OBJECT) {
           linked_list_append(list, elem_target, ((json_object_descriptor_t *)element_desc->descriptor)->deallocator);
         } else if (element_desc->type != UNKNOWN) {
           linked_list_append(list, elem_target, NULL);
         }
         state = ARRAY_NEXT;
+      } else {
+        // Fields parsed before the error still own their values.
+        json_free_value(elem_target, *element_desc);
+        free(elem_target);
       }
       break;
     case ARRAY_NEXT:
@@ -511,10 +1124,13 @@ int json_parse_array(const char *input, int *offset, void *target, json_descript
   }
 
   int list_size = linked_list_size(list), element_size = json_element_size(*element_desc), arr_ind = 0;
-  if (error == 0 && list_size > 0 && target != NULL) {
-    void *array = calloc(list_size, element_size);
+  if (error == 0 && target != NULL) {
+    void *array = NULL;
+    if (list_size > 0) {
+      array = calloc(list_size, element_size);
+    }
 
-    linked_list_node_t *node = list->head, *next = node->next;
+    linked_list_node_t *node = list->head, *next = NULL;
     while (node != NULL) {
       next = node->next;
       memcpy(array + arr_ind * element_size, node->value, element_size);
@@ -530,6 +1146,11 @@ int json_parse_array(const char *input, int *offset, void *target, json_descript
 
   if (error == 0) {
     *offset = index;
+  } else {
+    // The elements were never handed over, free what they own.
+    for (linked_list_node_t *node = list->head; node != NULL; node = node->next) {
+      json_free_value(node->value, *element_desc);
+    }
   }
 
   linked_list_free(list);
@@ -537,6 +1158,16 @@ int json_parse_array(const char *input, int *offset, void *target, json_descript
   return error;
 }
 
+json_property_descriptor_t *json_object_find_property(json_object_descriptor_t *desc, const char *name, int length) {
+  for (int idx = 0; idx < desc->num_props; idx++) {
+    json_property_descriptor_t *prop = &desc->props[idx];
+    if (strncmp(prop->name, name, length) == 0 && prop->name[length] == '\0') {
+      return prop;
+    }
+  }
+  return NULL;
+}
+
 json_property_descriptor_t *json_object_get_property(json_object_descriptor_t desc, const char *name) {
   for (int idx = 0; idx < desc.num_props; idx++) {
     json_property_descriptor_t prop = desc.props[idx];
@@ -547,22 +1178,209 @@ json_property_descriptor_t *json_object_get_property(json_object_descriptor_t de
   return NULL;
 }
 
-int json_parse_object(const char *input, int *offset, void *target, json_descriptor_t desc) {
-  int length = strlen(input) - (*offset);
-  if (length <= 0) {
-    return OUT_OF_BOUNDS;
+void *json_object_prop_target(void *context, json_property_descriptor_t *prop) {
+  if (context == NULL) {
+    return NULL;
   }
+  return context + prop->offset;
+}
 
-  json_object_descriptor_t *obj_desc = desc.descriptor;
-  if (obj_desc == NULL) {
-    return BAD_SPEC;
+/* Filters */
+
+json_filter_t *json_object_get_filter(json_object_descriptor_t *obj_desc, const char *name, int length) {
+  for (int idx = 0; idx < obj_desc->num_filters; idx++) {
+    json_filter_t *filter = &obj_desc->filters[idx];
+    if (strncmp(filter->name, name, length) == 0 && filter->name[length] == '\0') {
+      return filter;
+    }
+  }
+  return NULL;
+}
+
+int json_filter_match_string(json_filter_t *filter, const char *value, int length) {
+  if (filter->type != FILTER_EQUALS) {
+    return 0;
+  }
+  return strncmp(filter->string, value, length) == 0 && filter->string[length] == '\0';
+}
+
+int json_filter_match_number(json_filter_t *filter, double value) {
+  if (filter->type != FILTER_RANGE) {
+    return 0;
+  }
+  return value >= filter->min && value <= filter->max;
+}
+
+/**
+ * Evaluates a filter against the value at index, and skips over that value.
+ */
+int json_filter_value(const char *input, int *index, json_filter_t *filter, int *matches) {
+  int start = 0, end = 0, escaped = 0, error = 0;
+
+  while (is_whitespace(input[*index])) {
+    *index += 1;
+  }
+
+  *matches = 0;
+  if (input[*index] == '"') {
+    error = json_string_extent(input, *index, &start, &end, &escaped);
+    if (error == 0 && filter->type == FILTER_EQUALS) {
+      if (escaped) {
+        char local[256], *buffer = end - start < (int)sizeof(local) ? local : malloc(end - start + 1);
+        int length = json_string_decode(input, start, end, buffer);
+        *matches = length >= 0 && json_filter_match_string(filter, buffer, length);
+        if (buffer != local) {
+          free(buffer);
+        }
+      } else {
+        *matches = json_filter_match_string(filter, input + start, end - start);
+      }
+    }
+    if (error == 0) {
+      *index = end + 1;
+    }
+  } else if (filter->type == FILTER_RANGE && (is_digit(input[*index]) || input[*index] == '-')) {
+    double value = 0;
+    error = json_parse_float(input, index, &value);
+    if (error == 0) {
+      *matches = json_filter_match_number(filter, value);
+    }
+  } else {
+    error = json_skip_value(input, index);
+  }
+
+  return error;
+}
+
+void json_filter_set_init(json_filter_set_t *set, int num_filters) {
+  set->bits = 0;
+  set->flags = num_filters > 64 ? calloc(num_filters, sizeof(char)) : NULL;
+}
+
+int json_filter_set_add(json_filter_set_t *set, int slot) {
+  int seen = 0;
+  if (set->flags != NULL) {
+    seen = set->flags[slot];
+    set->flags[slot] = 1;
+  } else {
+    seen = (set->bits >> slot) & 1;
+    set->bits |= 1ULL << slot;
+  }
+  return !seen;
+}
+
+void json_filter_set_free(json_filter_set_t *set) {
+  free(set->flags);
+  set->flags = NULL;
+}
+
+/**
+ * Scans the keys of the object at offset ahead of the parser and evaluates
+ * the object's filters against them. Stops as soon as every filter has
+ * matched. If any filter fails, or its key is missing, *passed is cleared
+ * and the offset is moved past the object, so that it can be dropped without
+ * parsing anything.
+ */
+int json_object_filter(const char *input, int *offset, json_object_descriptor_t *obj_desc, int *passed) {
+  int index = *offset, error = 0, remaining = obj_desc->num_filters, failed = 0;
+  int start = 0, end = 0, escaped = 0;
+
+  json_filter_set_t matched;
+  json_filter_set_init(&matched, obj_desc->num_filters);
+
+  while (is_whitespace(input[index])) {
+    index += 1;
+  }
+  if (input[index] != '{') {
+    error = BAD_FORMAT;
+  }
+  index += 1;
+
+  while (error == 0 && remaining > 0) {
+    while (is_whitespace(input[index])) {
+      index += 1;
+    }
+    if (input[index] == '}') {
+      index += 1;
+      failed = 1;
+      break;
+    }
+
+    error = json_string_extent(input, index, &start, &end, &escaped);
+    if (error != 0) {
+      break;
+    }
+
+    json_filter_t *filter = NULL;
+    if (!failed && escaped) {
+      char local[256], *buffer = end - start < (int)sizeof(local) ? local : malloc(end - start + 1);
+      int length = json_string_decode(input, start, end, buffer);
+      filter = length < 0 ? NULL : json_object_get_filter(obj_desc, buffer, length);
+      if (buffer != local) {
+        free(buffer);
+      }
+    } else if (!failed) {
+      filter = json_object_get_filter(obj_desc, input + start, end - start);
+    }
+
+    index = end + 1;
+    while (is_whitespace(input[index])) {
+      index += 1;
+    }
+    if (input[index] != ':') {
+      error = BAD_FORMAT;
+      break;
+    }
+    index += 1;
+
+    if (filter != NULL) {
+      int matches = 0;
+      error = json_filter_value(input, &index, filter, &matches);
+      if (!matches) {
+        failed = 1;
+      } else if (json_filter_set_add(&matched, filter - obj_desc->filters)) {
+        remaining -= 1;
+      }
+    } else {
+      error = json_skip_value(input, &index);
+    }
+
+    while (error == 0 && is_whitespace(input[index])) {
+      index += 1;
+    }
+    if (error == 0 && input[index] == ',') {
+      index += 1;
+    } else if (error == 0 && input[index] == '}') {
+      index += 1;
+      failed = failed || remaining > 0;
+      break;
+    } else if (error == 0) {
+      error = BAD_FORMAT;
+    }
+  }
+
+  json_filter_set_free(&matched);
+
+  if (error == 0) {
+    *passed = !failed;
+    if (failed) {
+      *offset = index;
+    }
+  }
+
+  return error;
+}
+
+int json_parse_object_props(const char *input, int *offset, json_object_descriptor_t *obj_desc, json_prop_target_t prop_target, void *context) {
+  if (input[*offset] == '\0') {
+    return OUT_OF_BOUNDS;
   }
 
   int state = INIT, error = 0, index = *offset;
   char *prop_name = NULL;
   json_property_descriptor_t *prop = NULL;
 
-  while (index < strlen(input) && error == 0 && state != END) {
+  while (input[index] != '\0' && error == 0 && state != END) {
     char symbol = input[index];
 
     switch (state) {
@@ -599,7 +1417,7 @@ int json_parse_object(const char *input, int *offset, void *target, json_descrip
       if (prop == NULL) {
         error = json_parse_unknown(input, &index);
       } else {
-        error = json_parse_value(input, &index, target + prop->offset, prop->descriptor);
+        error = json_parse_value(input, &index, prop_target(context, prop), prop->descriptor);
       }
 
       free(prop_name);
@@ -648,6 +1466,232 @@ int json_parse_object(const char *input, int *offset, void *target, json_descrip
   return error;
 }
 
+int json_parse_object(const char *input, int *offset, void *target, json_descriptor_t desc) {
+  json_object_descriptor_t *obj_desc = desc.descriptor;
+  if (obj_desc == NULL) {
+    return BAD_SPEC;
+  }
+
+  return json_parse_object_props(input, offset, obj_desc, json_object_prop_target, target);
+}
+
+/**
+ * Returns FILTERED_OUT, with the offset moved past the object, if the object
+ * at offset doesn't pass the filters of its descriptor.
+ */
+int json_object_check_filters(const char *input, int *offset, json_object_descriptor_t *obj_desc) {
+  if (obj_desc == NULL || obj_desc->num_filters == 0) {
+    return 0;
+  }
+
+  int passed = 0;
+  int error = json_object_filter(input, offset, obj_desc, &passed);
+  if (error == 0 && !passed) {
+    error = FILTERED_OUT;
+  }
+  return error;
+}
+
+/**
+ * Parses an element of an array. Filters only apply to array elements, so
+ * this is the only place objects are checked against them.
+ */
+int json_parse_element(const char *input, int *offset, void *target, json_descriptor_t desc) {
+  if (desc.type == OBJECT) {
+    int error = json_object_check_filters(input, offset, desc.descriptor);
+    if (error != 0) {
+      return error;
+    }
+  }
+
+  return json_parse_value(input, offset, target, desc);
+}
+
+/* Columnar arrays */
+
+void *json_columns_prop_target(void *context, json_property_descriptor_t *prop) {
+  json_columns_context_t *columns = context;
+  if (columns->target == NULL) {
+    return NULL;
+  }
+
+  list_t *column = columns->target + prop->offset;
+  return column->items + columns->row * json_element_size(prop->descriptor);
+}
+
+int json_columns_grow(void *target, json_object_descriptor_t *obj_desc, int capacity, int new_capacity) {
+  for (int idx = 0; idx < obj_desc->num_props; idx++) {
+    json_property_descriptor_t *prop = &obj_desc->props[idx];
+    list_t *column = target + prop->offset;
+    int element_size = json_element_size(prop->descriptor);
+
+    void *items = realloc(column->items, new_capacity * element_size);
+    if (items == NULL) {
+      return OUT_OF_BOUNDS;
+    }
+    if (new_capacity > capacity) {
+      memset(items + capacity * element_size, 0, (new_capacity - capacity) * element_size);
+    }
+    column->items = items;
+  }
+  return 0;
+}
+
+int json_parse_columns(const char *input, int *offset, void *target, json_descriptor_t desc) {
+  if (input[*offset] == '\0') {
+    return OUT_OF_BOUNDS;
+  }
+
+  json_descriptor_t *element_desc = desc.descriptor;
+  if (element_desc == NULL || element_desc->type != OBJECT) {
+    return BAD_SPEC;
+  }
+
+  json_object_descriptor_t *obj_desc = element_desc->descriptor;
+  json_columns_context_t context = { .target = target, .row = 0 };
+  int state = INIT, error = 0, index = *offset, capacity = 0;
+
+  if (target != NULL) {
+    for (int idx = 0; idx < obj_desc->num_props; idx++) {
+      list_t *column = target + obj_desc->props[idx].offset;
+      column->size = 0;
+      column->items = NULL;
+    }
+  }
+
+  while (input[index] != '\0' && error == 0 && state != END) {
+    char symbol = input[index];
+
+    switch (state) {
+    case INIT:
+      if (is_whitespace(symbol)) {
+        // Skip whitespace symbols.
+      } else if (symbol == '[') {
+        state = ARRAY_VALUE;
+      } else {
+        error = BAD_FORMAT;
+      }
+      index += 1;
+      break;
+    case ARRAY_VALUE:
+      if (is_whitespace(symbol)) {
+        // Skip whitespace symbols.
+        index += 1;
+        break;
+      } else if (symbol == ']' && context.row == 0) {
+        index += 1;
+        state = END;
+        break;
+      }
+
+      error = json_object_check_filters(input, &index, obj_desc);
+      if (error == 0 && target != NULL && context.row == capacity) {
+        int new_capacity = capacity == 0 ? 16 : capacity * 2;
+        error = json_columns_grow(target, obj_desc, capacity, new_capacity);
+        if (error == 0) {
+          capacity = new_capacity;
+        }
+      }
+      if (error == 0) {
+        error = json_parse_object_props(input, &index, obj_desc, json_columns_prop_target, &context);
+      }
+      if (error == FILTERED_OUT) {
+        // Nothing was written, the row is reused by the next element.
+        error = 0;
+        state = ARRAY_NEXT;
+      } else if (error == 0) {
+        context.row += 1;
+        state = ARRAY_NEXT;
+      }
+      break;
+    case ARRAY_NEXT:
+      if (is_whitespace(symbol)) {
+        // Skip whitespace symbols.
+      } else if (symbol == ',') {
+        state = ARRAY_VALUE;
+      } else if (symbol == ']') {
+        state = END;
+      } else {
+        error = BAD_FORMAT;
+      }
+      index += 1;
+      break;
+    }
+  }
+
+  if (target != NULL) {
+    if (error == 0 && context.row > 0) {
+      // Give back the unused tail of every column. A column that can't
+      // shrink keeps its bigger buffer.
+      json_columns_grow(target, obj_desc, capacity, context.row);
+    }
+
+    for (int idx = 0; idx < obj_desc->num_props; idx++) {
+      json_property_descriptor_t *prop = &obj_desc->props[idx];
+      list_t *column = target + prop->offset;
+      if (error == 0 && context.row > 0) {
+        column->size = context.row;
+      } else {
+        // Free what the parsed rows, and the row that failed, own.
+        json_descriptor_t column_desc = { .type = ARRAY, .descriptor = &prop->descriptor };
+        column->size = context.row < capacity ? context.row + 1 : capacity;
+        json_free_value(column, column_desc);
+      }
+    }
+  }
+
+  if (error == 0) {
+    *offset = index;
+  }
+
+  return error;
+}
+
+/* Deallocation */
+
+void json_free_value(void *target, json_descriptor_t desc) {
+  if (target == NULL || desc.type == UNKNOWN) {
+    return;
+  }
+
+  json_descriptor_t *element_desc = desc.descriptor;
+  json_object_descriptor_t *obj_desc = NULL;
+  list_t *list = target;
+
+  switch (desc.type) {
+  case STRING:
+    free(*(char **)target);
+    break;
+  case ARRAY:
+    if (list->items != NULL) {
+      int element_size = json_element_size(*element_desc);
+      for (size_t idx = 0; idx < list->size; idx++) {
+        json_free_value(list->items + idx * element_size, *element_desc);
+      }
+    }
+    free(list->items);
+    break;
+  case OBJECT:
+    obj_desc = desc.descriptor;
+    for (int idx = 0; idx < obj_desc->num_props; idx++) {
+      json_property_descriptor_t *prop = &obj_desc->props[idx];
+      json_free_value(target + prop->offset, prop->descriptor);
+    }
+    break;
+  case COLUMNS:
+    obj_desc = element_desc->descriptor;
+    for (int idx = 0; idx < obj_desc->num_props; idx++) {
+      json_property_descriptor_t *prop = &obj_desc->props[idx];
+      json_descriptor_t column_desc = { .type = ARRAY, .descriptor = &prop->descriptor };
+      json_free_value(target + prop->offset, column_desc);
+    }
+    break;
+  }
+
+  // Interned strings belong to their table, so they're only forgotten.
+  memset(target, 0, json_element_size(desc));
+}
+
 /* API */
 
 int json_parse(const char *input, void *target, json_descriptor_t descriptor) {
@@ -657,3 +1701,34 @@ int json_parse(const char *input, void *target, json_descriptor_t descriptor) {
   return error;
 }
 
+void json_prepare(json_descriptor_t descriptor) {
+  json_object_descriptor_t *obj_desc = NULL;
+
+  if (descriptor.descriptor == NULL) {
+    return;
+  }
+
+  switch (descriptor.type) {
+  case ENUM:
+    json_enum_prepare(descriptor.descriptor);
+    break;
+  case ARRAY:
+  case COLUMNS:
+    json_prepare(*(json_descriptor_t *)descriptor.descriptor);
+    break;
+  case OBJECT:
+    obj_desc = descriptor.descriptor;
+    for (int idx = 0; idx < obj_desc->num_props; idx++) {
+      json_prepare(obj_desc->props[idx].descriptor);
+    }
+    break;
+  }
+}
+
+int json_parse_strict(const char *input, void *target, json_descriptor_t descriptor) {
+  if (!utf8_validate(input, strlen(input))) {
+    return BAD_ENCODING;
+  }
+
+  return json_parse(input, target, descriptor);
+}
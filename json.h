@@ -12,7 +12,10 @@ enum json_type_t {
   BOOL = 4,
   ARRAY = 5,
   OBJECT = 6,
-  UNKNOWN = 7
+  UNKNOWN = 7,
+  COLUMNS = 8,
+  STRING_INTERNED = 9,
+  ENUM = 10
 };
 
 typedef void *(*allocator_t)();
@@ -29,18 +32,63 @@ typedef struct {
   size_t offset;
 } json_property_descriptor_t;
 
+enum json_filter_type_t {
+  FILTER_EQUALS = 0,
+  FILTER_RANGE = 1
+};
+
+typedef struct {
+  char *name;
+  int type;
+  char *string;
+  double min;
+  double max;
+} json_filter_t;
+
 typedef struct {
   allocator_t allocator;
   deallocator_t deallocator;
   size_t size;
   int num_props;
   json_property_descriptor_t *props;
+  int num_filters;
+  json_filter_t *filters;
 } json_object_descriptor_t;
 
+typedef struct {
+  char *name;
+  int value;
+  unsigned int hash;
+  size_t length;
+} json_enum_value_t;
+
+typedef struct {
+  int num_values;
+  json_enum_value_t *values;
+  int prepared;
+  // Open addressing table of value positions plus one, zero for an empty
+  // slot. Without one, values are looked up one by one.
+  int *index;
+  size_t index_size;
+} json_enum_descriptor_t;
+
 /* API */
 
 int json_parse(const char *input, void *target, json_descriptor_t descriptor);
 
+/**
+ * Same as json_parse, but rejects input that isn't valid UTF-8 before
+ * parsing it.
+ **/
+int json_parse_strict(const char *input, void *target, json_descriptor_t descriptor);
+
+/**
+ * Precomputes lookup data inside the descriptor, such as the hash index of
+ * enum values. Parsing does this lazily on first use, which writes into the
+ * descriptor, so call this once before sharing a descriptor between threads.
+ **/
+void json_prepare(json_descriptor_t descriptor);
+
 /**
  * JSON spec costructors.
  *
@@ -67,12 +115,65 @@ int json_parse(const char *input, void *target, json_descriptor_t descriptor);
 #define JSON_STRING { .type = STRING }
 #define JSON_BOOL { .type = BOOL }
 
+/**
+ * String interned in an intern_table_t (see interntable.h). Identical values
+ * share a single copy owned by the table, so they can be compared by pointer
+ * and must not be freed by the caller.
+ **/
+
+#define JSON_STRING_INTERNED(table) { .type = STRING_INTERNED, .descriptor = table }
+
+/**
+ * String mapped to an int through a table of known values. Unknown strings
+ * fail the parse. Values are found through a hash index, which is built by
+ * json_prepare, or on first use if it wasn't called. The index has twice as
+ * many slots as there are values, and lives as long as the descriptor.
+ *
+ * json_enum_value_t events[] = {
+ *   JSON_ENUM_VALUE("click", EVENT_CLICK),
+ *   JSON_ENUM_VALUE("view", EVENT_VIEW)
+ * };
+ *
+ * json_descriptor_t desc = JSON_ENUM(events);
+ **/
+
+#define JSON_ENUM_VALUE(vname, val) { .name = vname, .value = val }
+
+#define JSON_ENUM(table) { \
+.type = ENUM, \
+.descriptor = &(json_enum_descriptor_t){ \
+  .num_values = sizeof(table) / sizeof(table[0]), \
+  .values = table, \
+  .index = (int[2 * sizeof(table) / sizeof(table[0])]){ 0 }, \
+  .index_size = 2 * sizeof(table) / sizeof(table[0]) \
+} \
+}
+
 #define JSON_ARRAY { \
 .type = ARRAY, \
 .descriptor = &(json_descriptor_t)
 
 #define JSON_ARRAY_END }
 
+/**
+ * Columnar array of objects. Instead of an array of structs, every property
+ * of the element object is collected into its own list_t column. The
+ * JSON_OBJECT inside describes a struct of columns: its size is the size of
+ * that struct, and each property offset points at the list_t column for it.
+ *
+ * json_descriptor_t desc =
+ * JSON_COLUMNAR_ARRAY
+ *   JSON_OBJECT(NULL, NULL, sizeof(mycolumns), 2)
+ *     JSON_PROPERTY(id, JSON_INT, offsetof(mycolumns, ids)),
+ *     JSON_PROPERTY(price, JSON_FLOAT, offsetof(mycolumns, prices))
+ *   JSON_OBJECT_END
+ * JSON_ARRAY_END;
+ **/
+
+#define JSON_COLUMNAR_ARRAY { \
+.type = COLUMNS, \
+.descriptor = &(json_descriptor_t)
+
 #define JSON_OBJECT(alloc, dealloc, osize, num) { \
 .type = OBJECT, \
 .descriptor = &(json_object_descriptor_t){ \
@@ -82,6 +183,41 @@ int json_parse(const char *input, void *target, json_descriptor_t descriptor);
   .num_props = num, \
   .props = (json_property_descriptor_t[]){
 
+/**
+ * Filters for objects inside arrays. Objects that don't pass all of the
+ * filters are skipped without being parsed and don't end up in the list.
+ * A filter on a missing key fails. An object that isn't an array element,
+ * such as the top-level value or a property, is parsed regardless of its
+ * filters. Filters go after the properties:
+ *
+ * JSON_ARRAY
+ *   JSON_OBJECT(event_alloc, event_dealloc, sizeof(event), 2)
+ *     JSON_PROPERTY(type, JSON_STRING, offsetof(event, type)),
+ *     JSON_PROPERTY(ts, JSON_INT, offsetof(event, ts))
+ *   JSON_OBJECT_WHERE(2)
+ *     JSON_FILTER_EQUALS(type, "click"),
+ *     JSON_FILTER_RANGE(ts, 1000, 2000)
+ *   JSON_OBJECT_END
+ * JSON_ARRAY_END;
+ **/
+
+#define JSON_OBJECT_WHERE(num) }, \
+  .num_filters = num, \
+  .filters = (json_filter_t[]){
+
+#define JSON_FILTER_EQUALS(fname, value) { \
+.name = #fname, \
+.type = FILTER_EQUALS, \
+.string = value \
+}
+
+#define JSON_FILTER_RANGE(fname, from, to) { \
+.name = #fname, \
+.type = FILTER_RANGE, \
+.min = from, \
+.max = to \
+}
+
 #define JSON_OBJECT_END } \
 } \
 }
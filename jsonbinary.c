@@ -0,0 +1,701 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
+
+#include "json.h"
+#include "jsonbinary.h"
+#include "jsoninternal.h"
+#include "genericlist.h"
+#include "interntable.h"
+
+enum json_binary_format {
+  MSGPACK = 0,
+  CBOR = 1
+};
+
+enum json_binary_kind {
+  BINARY_NIL = 0,
+  BINARY_BOOL = 1,
+  BINARY_INT = 2,
+  BINARY_UINT = 3,
+  BINARY_FLOAT = 4,
+  BINARY_STRING = 5,
+  BINARY_BYTES = 6,
+  BINARY_ARRAY = 7,
+  BINARY_MAP = 8,
+  BINARY_BREAK = 9
+};
+
+typedef struct {
+  const unsigned char *input;
+  size_t length;
+  size_t offset;
+  int format;
+} json_binary_reader_t;
+
+typedef struct {
+  int kind;
+  int64_t integer;
+  uint64_t uinteger;
+  double number;
+  const char *string;
+  size_t length;
+  int indefinite;
+} json_binary_item_t;
+
+int json_binary_value(json_binary_reader_t *reader, void *target, json_descriptor_t desc);
+
+/* Reading */
+
+int json_binary_read(json_binary_reader_t *reader, size_t count, const unsigned char **data) {
+  if (count > reader->length - reader->offset) {
+    return OUT_OF_BOUNDS;
+  }
+  *data = reader->input + reader->offset;
+  reader->offset += count;
+  return 0;
+}
+
+int json_binary_read_uint(json_binary_reader_t *reader, int size, uint64_t *value) {
+  const unsigned char *data = NULL;
+  int error = json_binary_read(reader, size, &data);
+
+  *value = 0;
+  for (int idx = 0; idx < size && error == 0; idx++) {
+    *value = (*value << 8) | data[idx];
+  }
+  return error;
+}
+
+double json_binary_half(uint64_t bits) {
+  int exponent = (bits >> 10) & 0x1f;
+  double mantissa = bits & 0x3ff, value = 0;
+
+  if (exponent == 0) {
+    value = ldexp(mantissa, -24);
+  } else if (exponent == 31) {
+    value = mantissa == 0 ? INFINITY : NAN;
+  } else {
+    value = ldexp(mantissa + 1024, exponent - 25);
+  }
+  return (bits & 0x8000) ? -value : value;
+}
+
+double json_binary_float(uint64_t bits, int size) {
+  if (size == 2) {
+    return json_binary_half(bits);
+  } else if (size == 4) {
+    uint32_t narrow = bits;
+    float value = 0;
+    memcpy(&value, &narrow, sizeof(value));
+    return value;
+  } else {
+    double value = 0;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+}
+
+int json_msgpack_next(json_binary_reader_t *reader, json_binary_item_t *item) {
+  const unsigned char *data = NULL;
+  uint64_t value = 0;
+  int error = json_binary_read(reader, 1, &data);
+  if (error != 0) {
+    return error;
+  }
+
+  unsigned char byte = *data;
+  memset(item, 0, sizeof(json_binary_item_t));
+
+  if (byte <= 0x7f) {
+    item->kind = BINARY_UINT;
+    item->uinteger = byte;
+  } else if (byte >= 0xe0) {
+    item->kind = BINARY_INT;
+    item->integer = (int8_t)byte;
+  } else if (byte <= 0x8f) {
+    item->kind = BINARY_MAP;
+    item->length = byte & 0x0f;
+  } else if (byte <= 0x9f) {
+    item->kind = BINARY_ARRAY;
+    item->length = byte & 0x0f;
+  } else if (byte <= 0xbf) {
+    item->kind = BINARY_STRING;
+    item->length = byte & 0x1f;
+  } else {
+    switch (byte) {
+    case 0xc0:
+      item->kind = BINARY_NIL;
+      break;
+    case 0xc2:
+    case 0xc3:
+      item->kind = BINARY_BOOL;
+      item->uinteger = byte & 1;
+      break;
+    case 0xc4:
+    case 0xc5:
+    case 0xc6:
+      item->kind = BINARY_BYTES;
+      error = json_binary_read_uint(reader, 1 << (byte - 0xc4), &value);
+      item->length = value;
+      break;
+    case 0xc7:
+    case 0xc8:
+    case 0xc9:
+      // Extension: length, type byte and data, skipped as bytes.
+      item->kind = BINARY_BYTES;
+      error = json_binary_read_uint(reader, 1 << (byte - 0xc7), &value);
+      item->length = value + 1;
+      break;
+    case 0xca:
+    case 0xcb:
+      item->kind = BINARY_FLOAT;
+      error = json_binary_read_uint(reader, byte == 0xca ? 4 : 8, &value);
+      item->number = json_binary_float(value, byte == 0xca ? 4 : 8);
+      break;
+    case 0xcc:
+    case 0xcd:
+    case 0xce:
+    case 0xcf:
+      item->kind = BINARY_UINT;
+      error = json_binary_read_uint(reader, 1 << (byte - 0xcc), &item->uinteger);
+      break;
+    case 0xd0:
+    case 0xd1:
+    case 0xd2:
+    case 0xd3:
+      item->kind = BINARY_INT;
+      error = json_binary_read_uint(reader, 1 << (byte - 0xd0), &value);
+      // Sign-extend from the encoded width.
+      int shift = 64 - 8 * (1 << (byte - 0xd0));
+      item->integer = shift == 0 ? (int64_t)value : ((int64_t)(value << shift)) >> shift;
+      break;
+    case 0xd4:
+    case 0xd5:
+    case 0xd6:
+    case 0xd7:
+    case 0xd8:
+      item->kind = BINARY_BYTES;
+      item->length = (1 << (byte - 0xd4)) + 1;
+      break;
+    case 0xd9:
+    case 0xda:
+    case 0xdb:
+      item->kind = BINARY_STRING;
+      error = json_binary_read_uint(reader, 1 << (byte - 0xd9), &value);
+      item->length = value;
+      break;
+    case 0xdc:
+    case 0xdd:
+      item->kind = BINARY_ARRAY;
+      error = json_binary_read_uint(reader, byte == 0xdc ? 2 : 4, &value);
+      item->length = value;
+      break;
+    case 0xde:
+    case 0xdf:
+      item->kind = BINARY_MAP;
+      error = json_binary_read_uint(reader, byte == 0xde ? 2 : 4, &value);
+      item->length = value;
+      break;
+    default:
+      error = BAD_FORMAT;
+    }
+  }
+
+  if (error == 0 && (item->kind == BINARY_STRING || item->kind == BINARY_BYTES)) {
+    error = json_binary_read(reader, item->length, &data);
+    item->string = (const char *)data;
+  }
+
+  return error;
+}
+
+int json_cbor_next(json_binary_reader_t *reader, json_binary_item_t *item) {
+  const unsigned char *data = NULL;
+  int error = 0;
+
+  do {
+    error = json_binary_read(reader, 1, &data);
+    if (error != 0) {
+      return error;
+    }
+
+    int major = *data >> 5, info = *data & 0x1f;
+    uint64_t argument = info;
+    memset(item, 0, sizeof(json_binary_item_t));
+
+    if (info >= 24 && info <= 27) {
+      error = json_binary_read_uint(reader, 1 << (info - 24), &argument);
+    } else if (info == 31) {
+      item->indefinite = 1;
+    } else if (info > 27) {
+      error = BAD_FORMAT;
+    }
+    if (error != 0) {
+      return error;
+    }
+
+    switch (major) {
+    case 0:
+      item->kind = BINARY_UINT;
+      item->uinteger = argument;
+      break;
+    case 1:
+      if (argument > INT64_MAX) {
+        return NUMBER_OVERFLOW;
+      }
+      item->kind = BINARY_INT;
+      item->integer = -1 - (int64_t)argument;
+      break;
+    case 2:
+    case 3:
+      if (item->indefinite) {
+        return NOT_SUPPORTED;
+      }
+      item->kind = major == 2 ? BINARY_BYTES : BINARY_STRING;
+      item->length = argument;
+      error = json_binary_read(reader, item->length, &data);
+      item->string = (const char *)data;
+      break;
+    case 4:
+    case 5:
+      item->kind = major == 4 ? BINARY_ARRAY : BINARY_MAP;
+      item->length = argument;
+      break;
+    case 6:
+      // Tags only annotate the item that follows.
+      item->kind = -1;
+      break;
+    case 7:
+      if (info == 20 || info == 21) {
+        item->kind = BINARY_BOOL;
+        item->uinteger = info == 21;
+      } else if (info == 22 || info == 23) {
+        item->kind = BINARY_NIL;
+      } else if (info >= 25 && info <= 27) {
+        item->kind = BINARY_FLOAT;
+        item->number = json_binary_float(argument, 1 << (info - 24));
+      } else if (info == 31) {
+        item->kind = BINARY_BREAK;
+      } else {
+        // Unassigned simple values.
+        item->kind = BINARY_NIL;
+      }
+      break;
+    }
+  } while (error == 0 && item->kind == -1);
+
+  return error;
+}
+
+int json_binary_next(json_binary_reader_t *reader, json_binary_item_t *item) {
+  if (reader->format == MSGPACK) {
+    return json_msgpack_next(reader, item);
+  }
+  return json_cbor_next(reader, item);
+}
+
+/**
+ * Checks whether a container has more entries. Definite containers count
+ * down, indefinite ones end with a break item.
+ */
+int json_binary_has_next(json_binary_reader_t *reader, json_binary_item_t *container, size_t index) {
+  if (!container->indefinite) {
+    return index < container->length;
+  }
+
+  if (reader->offset < reader->length && reader->input[reader->offset] == 0xff) {
+    reader->offset += 1;
+    return 0;
+  }
+  return reader->offset < reader->length;
+}
+
+int json_binary_skip_item(json_binary_reader_t *reader, json_binary_item_t *item) {
+  int error = 0;
+
+  if (item->kind == BINARY_ARRAY || item->kind == BINARY_MAP) {
+    int per_entry = item->kind == BINARY_MAP ? 2 : 1;
+    for (size_t idx = 0; error == 0 && json_binary_has_next(reader, item, idx); idx++) {
+      for (int part = 0; part < per_entry && error == 0; part++) {
+        json_binary_item_t child;
+        error = json_binary_next(reader, &child);
+        if (error == 0) {
+          error = json_binary_skip_item(reader, &child);
+        }
+      }
+    }
+  } else if (item->kind == BINARY_BREAK) {
+    error = BAD_FORMAT;
+  }
+
+  return error;
+}
+
+int json_binary_skip(json_binary_reader_t *reader) {
+  json_binary_item_t item;
+  int error = json_binary_next(reader, &item);
+  if (error == 0) {
+    error = json_binary_skip_item(reader, &item);
+  }
+  return error;
+}
+
+/* Descriptors */
+
+int json_binary_number(json_binary_item_t *item, double *value) {
+  if (item->kind == BINARY_UINT) {
+    *value = (double)item->uinteger;
+  } else if (item->kind == BINARY_INT) {
+    *value = (double)item->integer;
+  } else if (item->kind == BINARY_FLOAT) {
+    *value = item->number;
+  } else {
+    return BAD_FORMAT;
+  }
+  return 0;
+}
+
+/**
+ * Evaluates the object's filters against the map, then rewinds the reader.
+ * If the map doesn't pass, the reader is left right after it instead.
+ */
+int json_binary_filter(json_binary_reader_t *reader, json_binary_item_t *map, json_object_descriptor_t *obj_desc, int *passed) {
+  size_t start = reader->offset;
+  int error = 0, remaining = obj_desc->num_filters, failed = 0;
+  json_filter_set_t matched;
+  json_filter_set_init(&matched, obj_desc->num_filters);
+
+  for (size_t idx = 0; error == 0 && json_binary_has_next(reader, map, idx); idx++) {
+    json_binary_item_t key, value;
+    json_filter_t *filter = NULL;
+
+    error = json_binary_next(reader, &key);
+    if (error == 0 && key.kind == BINARY_STRING && !failed && remaining > 0) {
+      filter = json_object_get_filter(obj_desc, key.string, key.length);
+    } else if (error == 0) {
+      error = json_binary_skip_item(reader, &key);
+    }
+    if (error == 0) {
+      error = json_binary_next(reader, &value);
+    }
+    if (error != 0) {
+      break;
+    }
+
+    if (filter != NULL) {
+      double number = 0;
+      int matches = 0;
+      if (value.kind == BINARY_STRING) {
+        matches = json_filter_match_string(filter, value.string, value.length);
+      } else if (json_binary_number(&value, &number) == 0) {
+        matches = json_filter_match_number(filter, number);
+      }
+
+      if (!matches) {
+        failed = 1;
+      } else if (json_filter_set_add(&matched, filter - obj_desc->filters)) {
+        remaining -= 1;
+      }
+    }
+    error = json_binary_skip_item(reader, &value);
+
+    if (remaining == 0 && !failed) {
+      break;
+    }
+  }
+
+  json_filter_set_free(&matched);
+
+  *passed = !failed && remaining == 0;
+  if (*passed) {
+    reader->offset = start;
+  }
+  return error;
+}
+
+int json_binary_object(json_binary_reader_t *reader, json_binary_item_t *map, json_object_descriptor_t *obj_desc,
+    json_prop_target_t prop_target, void *context) {
+  int error = 0;
+
+  for (size_t idx = 0; error == 0 && json_binary_has_next(reader, map, idx); idx++) {
+    json_binary_item_t key;
+    json_property_descriptor_t *prop = NULL;
+
+    error = json_binary_next(reader, &key);
+    if (error == 0 && key.kind == BINARY_STRING) {
+      prop = json_object_find_property(obj_desc, key.string, key.length);
+    } else if (error == 0) {
+      error = json_binary_skip_item(reader, &key);
+    }
+
+    if (error == 0 && prop == NULL) {
+      error = json_binary_skip(reader);
+    } else if (error == 0) {
+      error = json_binary_value(reader, prop_target(context, prop), prop->descriptor);
+    }
+  }
+
+  return error;
+}
+
+/**
+ * Returns FILTERED_OUT, with the reader moved past the map, if the map
+ * doesn't pass the object's filters. Otherwise the reader is left as is.
+ */
+int json_binary_check_filters(json_binary_reader_t *reader, json_binary_item_t *map, json_object_descriptor_t *obj_desc) {
+  if (obj_desc->num_filters == 0) {
+    return 0;
+  }
+
+  int passed = 0;
+  int error = json_binary_filter(reader, map, obj_desc, &passed);
+  if (error == 0 && !passed) {
+    error = FILTERED_OUT;
+  }
+  return error;
+}
+
+/**
+ * Decodes an element of an array. Filters only apply to array elements, so
+ * this is where objects are checked against them.
+ */
+int json_binary_element(json_binary_reader_t *reader, void *target, json_descriptor_t desc) {
+  json_object_descriptor_t *obj_desc = desc.descriptor;
+  if (desc.type != OBJECT || obj_desc->num_filters == 0) {
+    return json_binary_value(reader, target, desc);
+  }
+
+  size_t start = reader->offset;
+  json_binary_item_t map;
+  int error = json_binary_next(reader, &map);
+  if (error == 0 && map.kind == BINARY_MAP) {
+    error = json_binary_check_filters(reader, &map, obj_desc);
+  }
+  if (error != 0) {
+    return error;
+  }
+
+  // Decode from the start again, so nil and type errors are handled as usual.
+  reader->offset = start;
+  return json_binary_value(reader, target, desc);
+}
+
+int json_binary_array(json_binary_reader_t *reader, json_binary_item_t *array, void *target, json_descriptor_t *element_desc) {
+  size_t element_size = json_element_size(*element_desc), size = 0, capacity = 0;
+  void *items = NULL;
+  int error = 0;
+
+  if (target != NULL && !array->indefinite) {
+    // Every element takes at least a byte, which bounds bogus counts.
+    capacity = array->length;
+    if (capacity > reader->length - reader->offset) {
+      return OUT_OF_BOUNDS;
+    }
+    items = calloc(capacity > 0 ? capacity : 1, element_size);
+  }
+
+  for (size_t idx = 0; error == 0 && json_binary_has_next(reader, array, idx); idx++) {
+    if (target == NULL) {
+      error = json_binary_skip(reader);
+      continue;
+    }
+
+    if (size == capacity) {
+      capacity = capacity == 0 ? 16 : capacity * 2;
+      items = realloc(items, capacity * element_size);
+    }
+
+    memset(items + size * element_size, 0, element_size);
+    error = json_binary_element(reader, items + size * element_size, *element_desc);
+    if (error == FILTERED_OUT) {
+      error = 0;
+    } else if (error == 0) {
+      size += 1;
+    }
+  }
+
+  if (error == 0 && target != NULL) {
+    list_t *target_list = target;
+    target_list->size = size;
+    target_list->items = size > 0 ? items : NULL;
+    if (size == 0) {
+      free(items);
+    }
+  } else if (items != NULL) {
+    // Free what the decoded elements, and the one that failed, own.
+    list_t decoded = { .size = size + 1, .items = items };
+    json_descriptor_t list_desc = { .type = ARRAY, .descriptor = element_desc };
+    json_free_value(&decoded, list_desc);
+  }
+
+  return error;
+}
+
+int json_binary_columns(json_binary_reader_t *reader, json_binary_item_t *array, void *target, json_object_descriptor_t *obj_desc) {
+  json_columns_context_t context = { .target = target, .row = 0 };
+  int error = 0, capacity = 0;
+
+  if (target != NULL) {
+    for (int idx = 0; idx < obj_desc->num_props; idx++) {
+      list_t *column = target + obj_desc->props[idx].offset;
+      column->size = 0;
+      column->items = NULL;
+    }
+  }
+
+  for (size_t idx = 0; error == 0 && json_binary_has_next(reader, array, idx); idx++) {
+    json_binary_item_t map;
+
+    error = json_binary_next(reader, &map);
+    if (error == 0 && map.kind != BINARY_MAP) {
+      error = BAD_FORMAT;
+    }
+    if (error == 0) {
+      error = json_binary_check_filters(reader, &map, obj_desc);
+    }
+
+    if (error == 0 && target != NULL && context.row == capacity) {
+      int new_capacity = capacity == 0 ? 16 : capacity * 2;
+      error = json_columns_grow(target, obj_desc, capacity, new_capacity);
+      if (error == 0) {
+        capacity = new_capacity;
+      }
+    }
+    if (error == 0) {
+      error = json_binary_object(reader, &map, obj_desc, json_columns_prop_target, &context);
+    }
+    if (error == FILTERED_OUT) {
+      error = 0;
+    } else if (error == 0) {
+      context.row += 1;
+    }
+  }
+
+  if (target != NULL) {
+    if (error == 0 && context.row > 0) {
+      // A column that can't shrink keeps its bigger buffer.
+      json_columns_grow(target, obj_desc, capacity, context.row);
+    }
+
+    for (int idx = 0; idx < obj_desc->num_props; idx++) {
+      json_property_descriptor_t *prop = &obj_desc->props[idx];
+      list_t *column = target + prop->offset;
+      if (error == 0 && context.row > 0) {
+        column->size = context.row;
+      } else {
+        json_descriptor_t column_desc = { .type = ARRAY, .descriptor = &prop->descriptor };
+        column->size = context.row < capacity ? context.row + 1 : capacity;
+        json_free_value(column, column_desc);
+      }
+    }
+  }
+
+  return error;
+}
+
+int json_binary_value(json_binary_reader_t *reader, void *target, json_descriptor_t desc) {
+  json_binary_item_t item;
+  double number = 0;
+  int error = json_binary_next(reader, &item);
+
+  if (error != 0) {
+    return error;
+  }
+
+  if (desc.type == UNKNOWN || item.kind == BINARY_NIL) {
+    return json_binary_skip_item(reader, &item);
+  }
+
+  switch (desc.type) {
+  case INT:
+    if (item.kind == BINARY_UINT && item.uinteger > INT_MAX) {
+      error = NUMBER_OVERFLOW;
+    } else if (item.kind == BINARY_INT && (item.integer < INT_MIN || item.integer > INT_MAX)) {
+      error = NUMBER_OVERFLOW;
+    } else if (item.kind != BINARY_UINT && item.kind != BINARY_INT) {
+      error = BAD_FORMAT;
+    } else if (target != NULL) {
+      *(int *)target = item.kind == BINARY_UINT ? (int)item.uinteger : (int)item.integer;
+    }
+    break;
+  case FLOAT:
+    error = json_binary_number(&item, &number);
+    if (error == 0 && target != NULL) {
+      *(double *)target = number;
+    }
+    break;
+  case BOOL:
+    if (item.kind != BINARY_BOOL) {
+      error = BAD_FORMAT;
+    } else if (target != NULL) {
+      *(int *)target = item.uinteger;
+    }
+    break;
+  case STRING:
+    if (item.kind != BINARY_STRING) {
+      error = BAD_FORMAT;
+    } else if (target != NULL) {
+      char *string = malloc(item.length + 1);
+      memcpy(string, item.string, item.length);
+      string[item.length] = '\0';
+      *(char **)target = string;
+    }
+    break;
+  case STRING_INTERNED:
+    if (item.kind != BINARY_STRING) {
+      error = BAD_FORMAT;
+    } else if (desc.descriptor == NULL) {
+      error = BAD_SPEC;
+    } else if (target != NULL) {
+      *(const char **)target = intern_table_get(desc.descriptor, item.string, item.length);
+    }
+    break;
+  case ENUM:
+    if (item.kind != BINARY_STRING) {
+      error = BAD_FORMAT;
+    } else if (target != NULL) {
+      error = json_enum_lookup(desc.descriptor, item.string, item.length, target);
+    }
+    break;
+  case ARRAY:
+    if (item.kind != BINARY_ARRAY) {
+      error = BAD_FORMAT;
+    } else {
+      error = json_binary_array(reader, &item, target, desc.descriptor);
+    }
+    break;
+  case COLUMNS:
+    if (item.kind != BINARY_ARRAY || ((json_descriptor_t *)desc.descriptor)->type != OBJECT) {
+      error = item.kind != BINARY_ARRAY ? BAD_FORMAT : BAD_SPEC;
+    } else {
+      error = json_binary_columns(reader, &item, target, ((json_descriptor_t *)desc.descriptor)->descriptor);
+    }
+    break;
+  case OBJECT:
+    if (item.kind != BINARY_MAP) {
+      error = BAD_FORMAT;
+    } else {
+      error = json_binary_object(reader, &item, desc.descriptor, json_object_prop_target, target);
+    }
+    break;
+  default:
+    error = NOT_SUPPORTED;
+  }
+
+  return error;
+}
+
+/* API */
+
+int json_parse_msgpack(const unsigned char *input, size_t length, void *target, json_descriptor_t descriptor) {
+  json_binary_reader_t reader = { .input = input, .length = length, .offset = 0, .format = MSGPACK };
+  return json_binary_value(&reader, target, descriptor);
+}
+
+int json_parse_cbor(const unsigned char *input, size_t length, void *target, json_descriptor_t descriptor) {
+  json_binary_reader_t reader = { .input = input, .length = length, .offset = 0, .format = CBOR };
+  return json_binary_value(&reader, target, descriptor);
+}
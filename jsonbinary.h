@@ -0,0 +1,49 @@
+#ifndef _H_JSON_BINARY
+#define _H_JSON_BINARY
+
+#include <stddef.h>
+
+#include "json.h"
+
+/**
+ * MessagePack and CBOR input.
+ *
+ * Both decoders fill targets using the same descriptors as json_parse, so
+ * switching the wire format doesn't require a second schema:
+ *
+ * json_parse(text, &target, desc);
+ * json_parse_msgpack(bytes, length, &target, desc);
+ * json_parse_cbor(bytes, length, &target, desc);
+ *
+ * Map keys are matched against property names, integers and floats convert
+ * into each other the same way they do in text, and nil/null values leave the
+ * target field untouched. Binary strings, extensions and tags are skipped.
+ * Indefinite-length CBOR arrays and maps are supported, indefinite-length
+ * CBOR strings are not.
+ */
+
+/**
+ * Parses MessagePack data into the target.
+ *
+ * @param input: MessagePack data.
+ * @param length: Length of the data.
+ * @param target: Target to fill.
+ * @param descriptor: Descriptor of the target.
+ *
+ * @return 0 on success, or a parse error code.
+ */
+int json_parse_msgpack(const unsigned char *input, size_t length, void *target, json_descriptor_t descriptor);
+
+/**
+ * Parses CBOR data into the target.
+ *
+ * @param input: CBOR data.
+ * @param length: Length of the data.
+ * @param target: Target to fill.
+ * @param descriptor: Descriptor of the target.
+ *
+ * @return 0 on success, or a parse error code.
+ */
+int json_parse_cbor(const unsigned char *input, size_t length, void *target, json_descriptor_t descriptor);
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef _H_JSON_INTERNAL
+#define _H_JSON_INTERNAL
+
+/**
+ * Scanners and helpers shared between json.c and the modules built on top of
+ * it. Not part of the public API.
+ */
+
+#include <stdint.h>
+
+#include "json.h"
+#include "interntable.h"
+
+enum json_parse_error {
+  NOT_SUPPORTED = 1,
+  OUT_OF_BOUNDS = 2,
+  BAD_FORMAT = 3,
+  BAD_SPEC = 4,
+  PROP_NOT_FOUND = 5,
+  NUMBER_OVERFLOW = 6,
+  VALUE_NOT_FOUND = 7,
+  FILTERED_OUT = 8,
+  IO_ERROR = 9,
+  BAD_ENCODING = 10
+};
+
+/* Internal API */
+
+/**
+ * Resolves where an object's property value should be written to. Lets the
+ * same object parser fill a plain struct or a row of a columnar array.
+ */
+typedef void *(*json_prop_target_t)(void *context, json_property_descriptor_t *prop);
+
+/**
+ * Row of a columnar array that is being filled.
+ */
+typedef struct {
+  void *target;
+  int row;
+} json_columns_context_t;
+
+/**
+ * Filters of an object that have matched so far: a bitmask, unless there are
+ * too many filters for it.
+ */
+typedef struct {
+  uint64_t bits;
+  char *flags;
+} json_filter_set_t;
+
+int is_whitespace(char symbol);
+int is_numeric(char symbol, int allow_minus_sign);
+int is_alpha(char symbol);
+int is_digit(char symbol);
+int is_delimiter(char symbol);
+int json_parse_int(const char *input, int *offset, void *target);
+int json_parse_float(const char *input, int *offset, void *target);
+int json_string_extent(const char *input, int index, int *start, int *end, int *escaped);
+int json_string_decode(const char *input, int start, int end, char *buffer);
+int json_parse_string(const char *input, int *offset, void *target);
+int json_parse_string_interned(const char *input, int *offset, void *target, intern_table_t *table);
+int json_parse_enum(const char *input, int *offset, void *target, json_enum_descriptor_t *enum_desc);
+int json_enum_lookup(json_enum_descriptor_t *enum_desc, const char *name, size_t length, int *target);
+int json_parse_bool(const char *input, int *offset, void *target);
+int json_skip_value(const char *input, int *offset);
+int json_parse_unknown(const char *input, int *offset);
+int json_parse_value(const char *input, int *offset, void *target, json_descriptor_t descriptor);
+int json_element_size(json_descriptor_t desc);
+void *json_array_element_alloc(json_descriptor_t desc);
+int json_parse_array(const char *input, int *offset, void *target, json_descriptor_t desc);
+int json_parse_object(const char *input, int *offset, void *target, json_descriptor_t desc);
+int json_object_check_filters(const char *input, int *offset, json_object_descriptor_t *obj_desc);
+int json_parse_element(const char *input, int *offset, void *target, json_descriptor_t desc);
+int json_parse_columns(const char *input, int *offset, void *target, json_descriptor_t desc);
+json_property_descriptor_t *json_object_find_property(json_object_descriptor_t *desc, const char *name, int length);
+void *json_object_prop_target(void *context, json_property_descriptor_t *prop);
+void *json_columns_prop_target(void *context, json_property_descriptor_t *prop);
+int json_columns_grow(void *target, json_object_descriptor_t *obj_desc, int capacity, int new_capacity);
+json_filter_t *json_object_get_filter(json_object_descriptor_t *obj_desc, const char *name, int length);
+int json_filter_match_string(json_filter_t *filter, const char *value, int length);
+int json_filter_match_number(json_filter_t *filter, double value);
+void json_filter_set_init(json_filter_set_t *set, int num_filters);
+int json_filter_set_add(json_filter_set_t *set, int slot);
+void json_filter_set_free(json_filter_set_t *set);
+void json_free_value(void *target, json_descriptor_t desc);
+
+#endif
@@ -0,0 +1,140 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "json.h"
+#include "jsonpatch.h"
+#include "jsoninternal.h"
+
+int json_patch_value(const char *patch, int *offset, void *target, json_descriptor_t desc);
+
+int json_patch_is_null(const char *patch, int index) {
+  return strncmp(patch + index, "null", 4) == 0 && is_delimiter(patch[index + 4]);
+}
+
+int json_patch_merge(const char *patch, int *offset, void *target, json_object_descriptor_t *obj_desc) {
+  int index = *offset + 1, error = 0;
+
+  while (is_whitespace(patch[index])) {
+    index += 1;
+  }
+  if (patch[index] == '}') {
+    *offset = index + 1;
+    return 0;
+  }
+
+  while (error == 0) {
+    int start = 0, end = 0, escaped = 0, length = 0;
+    char local[256], *decoded = NULL;
+    const char *key = NULL;
+
+    error = json_string_extent(patch, index, &start, &end, &escaped);
+    if (error != 0) {
+      break;
+    }
+
+    key = patch + start;
+    length = end - start;
+    if (escaped) {
+      decoded = length < (int)sizeof(local) ? local : malloc(length + 1);
+      length = json_string_decode(patch, start, end, decoded);
+      key = decoded;
+    }
+
+    json_property_descriptor_t *prop = NULL;
+    if (length >= 0) {
+      prop = json_object_find_property(obj_desc, key, length);
+    } else {
+      error = BAD_FORMAT;
+    }
+
+    if (decoded != NULL && decoded != local) {
+      free(decoded);
+    }
+    if (error != 0) {
+      break;
+    }
+
+    index = end + 1;
+    while (is_whitespace(patch[index])) {
+      index += 1;
+    }
+    if (patch[index] != ':') {
+      error = BAD_FORMAT;
+      break;
+    }
+    index += 1;
+
+    if (prop == NULL) {
+      error = json_skip_value(patch, &index);
+    } else {
+      error = json_patch_value(patch, &index, target + prop->offset, prop->descriptor);
+    }
+
+    while (error == 0 && is_whitespace(patch[index])) {
+      index += 1;
+    }
+    if (error == 0) {
+      if (patch[index] == ',') {
+        index += 1;
+      } else if (patch[index] == '}') {
+        index += 1;
+        break;
+      } else {
+        error = BAD_FORMAT;
+      }
+    }
+  }
+
+  if (error == 0) {
+    *offset = index;
+  }
+
+  return error;
+}
+
+int json_patch_value(const char *patch, int *offset, void *target, json_descriptor_t desc) {
+  int index = *offset, error = 0;
+
+  while (is_whitespace(patch[index])) {
+    index += 1;
+  }
+  if (patch[index] == '\0') {
+    return OUT_OF_BOUNDS;
+  }
+
+  if (json_patch_is_null(patch, index)) {
+    json_free_value(target, desc);
+    index += 4;
+  } else if (patch[index] == '{' && desc.type == OBJECT) {
+    error = json_patch_merge(patch, &index, target, desc.descriptor);
+  } else if (desc.type == UNKNOWN) {
+    error = json_skip_value(patch, &index);
+  } else {
+    // Parse the replacement on the side, so a bad value leaves the old one
+    // in place.
+    int size = json_element_size(desc);
+    void *value = calloc(1, size);
+
+    error = json_parse_value(patch, &index, value, desc);
+    if (error == 0) {
+      json_free_value(target, desc);
+      memcpy(target, value, size);
+    } else {
+      json_free_value(value, desc);
+    }
+
+    free(value);
+  }
+
+  if (error == 0) {
+    *offset = index;
+  }
+
+  return error;
+}
+
+int json_apply_patch(void *target, json_descriptor_t descriptor, const char *patch) {
+  int offset = 0;
+
+  return json_patch_value(patch, &offset, target, descriptor);
+}
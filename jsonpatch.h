@@ -0,0 +1,41 @@
+#ifndef _H_JSON_PATCH
+#define _H_JSON_PATCH
+
+#include "json.h"
+
+/**
+ * JSON Merge Patch (RFC 7386) applied to an already parsed target.
+ *
+ * The patch is walked together with the descriptor and only the fields it
+ * mentions are touched, so the cost depends on the size of the patch rather
+ * than the size of the document:
+ *
+ * - a nested object in the patch is merged into the nested object field,
+ * - null frees the field and resets it to zero,
+ * - any other value frees the old field and is parsed in its place,
+ * - keys that aren't in the descriptor are ignored.
+ *
+ * Example usage:
+ *
+ * myconfig config = { 0 };
+ * json_parse(document, &config, desc);
+ * json_apply_patch(&config, desc, "{\"server\":{\"port\":8080},\"motd\":null}");
+ *
+ * Fields are freed according to the descriptor, so the target must own its
+ * data: don't patch snapshots loaded with json_snapshot_load. Interned
+ * strings are left to their table.
+ */
+
+/**
+ * Applies a merge patch to the target.
+ *
+ * @param target: Parsed target to update.
+ * @param descriptor: Descriptor of the target.
+ * @param patch: Merge patch document.
+ *
+ * @return 0 on success, or an error code. A field whose new value fails to
+ *   parse keeps its old value, but members before it are already applied.
+ */
+int json_apply_patch(void *target, json_descriptor_t descriptor, const char *patch);
+
+#endif
@@ -0,0 +1,254 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "json.h"
+#include "jsonquery.h"
+#include "jsoninternal.h"
+
+/* Compilation */
+
+json_query_node_t *json_query_node_new(const char *segment, int length) {
+  json_query_node_t *node = calloc(1, sizeof(json_query_node_t));
+  node->segment = malloc(length + 1);
+  node->segment_length = length;
+  node->index = -1;
+
+  // Unescape "~1" into "/" and "~0" into "~".
+  int out = 0;
+  for (int idx = 0; idx < length; idx++) {
+    if (segment[idx] == '~' && idx + 1 < length && (segment[idx + 1] == '0' || segment[idx + 1] == '1')) {
+      node->segment[out] = segment[idx + 1] == '0' ? '~' : '/';
+      idx += 1;
+    } else {
+      node->segment[out] = segment[idx];
+    }
+    out += 1;
+  }
+  node->segment[out] = '\0';
+  node->segment_length = out;
+
+  if (out == 1 && node->segment[0] == '*') {
+    node->wildcard = 1;
+  } else if (out > 0 && out < 10 && (node->segment[0] != '0' || out == 1)) {
+    int index = 0;
+    for (int idx = 0; idx < out && index >= 0; idx++) {
+      index = is_digit(node->segment[idx]) ? index * 10 + (node->segment[idx] - '0') : -1;
+    }
+    node->index = index;
+  }
+
+  return node;
+}
+
+void json_query_node_free(json_query_node_t *node) {
+  for (int idx = 0; idx < node->num_children; idx++) {
+    json_query_node_free(node->children[idx]);
+  }
+  free(node->children);
+  free(node->paths);
+  free(node->segment);
+  free(node);
+}
+
+json_query_node_t *json_query_node_child(json_query_t *query, json_query_node_t *node, const char *segment, int length) {
+  json_query_node_t *child = json_query_node_new(segment, length);
+
+  for (int idx = 0; idx < node->num_children; idx++) {
+    json_query_node_t *existing = node->children[idx];
+    if (existing->segment_length == child->segment_length
+        && memcmp(existing->segment, child->segment, child->segment_length) == 0) {
+      json_query_node_free(child);
+      return existing;
+    }
+  }
+
+  node->children = realloc(node->children, (node->num_children + 1) * sizeof(json_query_node_t *));
+  node->children[node->num_children] = child;
+  node->num_children += 1;
+  query->num_nodes += 1;
+
+  return child;
+}
+
+json_query_t *json_query_compile(const char **paths, int num_paths) {
+  json_query_t *query = calloc(1, sizeof(json_query_t));
+  query->root = json_query_node_new("", 0);
+  query->num_nodes = 1;
+
+  for (int path = 0; path < num_paths; path++) {
+    const char *segment = paths[path];
+    json_query_node_t *node = query->root;
+    int depth = 0;
+
+    if (*segment != '\0' && *segment != '/') {
+      json_query_free(query);
+      return NULL;
+    }
+
+    while (*segment == '/') {
+      segment += 1;
+      const char *end = strchr(segment, '/');
+      int length = end == NULL ? strlen(segment) : end - segment;
+
+      node = json_query_node_child(query, node, segment, length);
+      segment += length;
+      depth += 1;
+    }
+
+    node->paths = realloc(node->paths, (node->num_paths + 1) * sizeof(int));
+    node->paths[node->num_paths] = path;
+    node->num_paths += 1;
+
+    if (depth > query->depth) {
+      query->depth = depth;
+    }
+  }
+
+  return query;
+}
+
+void json_query_free(json_query_t *query) {
+  json_query_node_free(query->root);
+  free(query);
+}
+
+/* Matching */
+
+int json_query_walk(json_query_t *query, const char *input, int *offset, json_query_node_t **active,
+    int num_active, json_query_node_t **next, json_query_callback_t callback, void *context) {
+  if (num_active == 0) {
+    return json_skip_value(input, offset);
+  }
+
+  int index = *offset, error = 0, position = 0;
+
+  while (is_whitespace(input[index])) {
+    index += 1;
+  }
+
+  int value_start = index;
+  char symbol = input[index];
+
+  if (symbol == '{' || symbol == '[') {
+    char closing = symbol == '{' ? '}' : ']';
+    index += 1;
+
+    while (is_whitespace(input[index])) {
+      index += 1;
+    }
+    if (input[index] == closing) {
+      index += 1;
+    } else {
+      while (error == 0) {
+        const char *key = NULL;
+        int key_length = 0, start = 0, end = 0, escaped = 0;
+        char local[256], *decoded = NULL;
+
+        if (closing == '}') {
+          error = json_string_extent(input, index, &start, &end, &escaped);
+          if (error != 0) {
+            break;
+          }
+
+          key = input + start;
+          key_length = end - start;
+          if (escaped) {
+            decoded = key_length < (int)sizeof(local) ? local : malloc(key_length + 1);
+            key_length = json_string_decode(input, start, end, decoded);
+            key = decoded;
+          }
+          if (key_length < 0) {
+            error = BAD_FORMAT;
+            if (decoded != local) {
+              free(decoded);
+            }
+            break;
+          }
+
+          index = end + 1;
+          while (is_whitespace(input[index])) {
+            index += 1;
+          }
+          if (input[index] != ':') {
+            error = BAD_FORMAT;
+            break;
+          }
+          index += 1;
+        }
+
+        // Advance every active node whose child matches this key or index.
+        int num_next = 0;
+        for (int idx = 0; idx < num_active; idx++) {
+          json_query_node_t *node = active[idx];
+          for (int child = 0; child < node->num_children; child++) {
+            json_query_node_t *candidate = node->children[child];
+            int matches = candidate->wildcard;
+            if (!matches && key != NULL) {
+              matches = candidate->segment_length == key_length && memcmp(candidate->segment, key, key_length) == 0;
+            } else if (!matches) {
+              matches = candidate->index == position;
+            }
+            if (matches) {
+              next[num_next] = candidate;
+              num_next += 1;
+            }
+          }
+        }
+
+        if (decoded != NULL && decoded != local) {
+          free(decoded);
+        }
+
+        error = json_query_walk(query, input, &index, next, num_next, next + query->num_nodes, callback, context);
+        position += 1;
+
+        while (error == 0 && is_whitespace(input[index])) {
+          index += 1;
+        }
+        if (error == 0) {
+          if (input[index] == ',') {
+            index += 1;
+          } else if (input[index] == closing) {
+            index += 1;
+            break;
+          } else {
+            error = BAD_FORMAT;
+          }
+        }
+      }
+    }
+  } else {
+    error = json_skip_value(input, &index);
+  }
+
+  if (error == 0) {
+    for (int idx = 0; idx < num_active; idx++) {
+      json_query_node_t *node = active[idx];
+      for (int path = 0; path < node->num_paths; path++) {
+        callback(node->paths[path], input + value_start, index - value_start, context);
+      }
+    }
+
+    *offset = index;
+  }
+
+  return error;
+}
+
+int json_query_run(json_query_t *query, const char *input, json_query_callback_t callback, void *context) {
+  int offset = 0;
+  json_query_node_t *root = query->root;
+
+  // One set of active nodes per nesting level, owned by this run so that a
+  // query can be run from several threads at once.
+  size_t size = (query->depth + 1) * query->num_nodes;
+  json_query_node_t *local[128], **scratch = size <= 128 ? local : malloc(size * sizeof(json_query_node_t *));
+
+  int error = json_query_walk(query, input, &offset, &root, 1, scratch, callback, context);
+
+  if (scratch != local) {
+    free(scratch);
+  }
+
+  return error;
+}
@@ -0,0 +1,84 @@
+#ifndef _H_JSON_QUERY
+#define _H_JSON_QUERY
+
+/**
+ * Compiled multi-path queries.
+ *
+ * A query is a set of JSON Pointer paths (RFC 6901), like "/meta/id" or
+ * "/items/0/name", compiled into a trie. Running it walks the input once,
+ * skipping every subtree that none of the paths can reach, and reports
+ * each matching value through a callback. A "*" segment matches any object
+ * key or array index.
+ *
+ * Example usage:
+ *
+ * const char *paths[] = { "/meta/id", "/items/0/price" };
+ * json_query_t *query = json_query_compile(paths, 2);
+ * json_query_run(query, input, on_match, &context);
+ * json_query_free(query);
+ *
+ * A compiled query isn't changed by running it, so it can be run from
+ * several threads at once.
+ *
+ * The callback receives the raw JSON text of the value, which can be parsed
+ * further with json_parse, since it stops at the end of the value:
+ *
+ * void on_match(int path, const char *value, int length, void *context) {
+ *   double price = 0;
+ *   json_parse(value, &price, (json_descriptor_t)JSON_FLOAT);
+ * }
+ */
+
+typedef struct json_query_node json_query_node_t;
+
+struct json_query_node {
+  char *segment;
+  int segment_length;
+  int index;
+  int wildcard;
+  int *paths;
+  int num_paths;
+  json_query_node_t **children;
+  int num_children;
+};
+
+typedef struct {
+  json_query_node_t *root;
+  int num_nodes;
+  int depth;
+} json_query_t;
+
+typedef void (*json_query_callback_t)(int path, const char *value, int length, void *context);
+
+/**
+ * Compiles a set of paths into a query.
+ *
+ * @param paths: JSON Pointer paths. An empty path matches the whole input.
+ * @param num_paths: Number of paths.
+ *
+ * @return A new query, or NULL if any of the paths is malformed.
+ */
+json_query_t *json_query_compile(const char **paths, int num_paths);
+
+/**
+ * Frees the query.
+ *
+ * @param query: Query to deallocate.
+ */
+void json_query_free(json_query_t *query);
+
+/**
+ * Runs the query over the input in a single pass. Values are reported in
+ * the order they end in the input, with the index of the matching path in
+ * the array passed to json_query_compile.
+ *
+ * @param query: Compiled query.
+ * @param input: JSON input.
+ * @param callback: Function to call for every matching value.
+ * @param context: Pointer passed through to the callback.
+ *
+ * @return 0 on success, or a parse error code.
+ */
+int json_query_run(json_query_t *query, const char *input, json_query_callback_t callback, void *context);
+
+#endif
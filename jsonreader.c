@@ -0,0 +1,320 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "json.h"
+#include "jsonreader.h"
+#include "jsoninternal.h"
+
+enum json_reader_state {
+  READER_START = 0,
+  READER_ARRAY = 1,
+  READER_SEQUENCE = 2,
+  READER_FINISHED = 3
+};
+
+typedef struct {
+  int started;
+  int depth;
+  int in_string;
+  int escape;
+  int scalar;
+} json_reader_scan_t;
+
+/* Reading thread */
+
+void *json_reader_fill(void *arg) {
+  json_reader_t *reader = arg;
+
+  pthread_mutex_lock(&reader->lock);
+  while (!reader->stop) {
+    while (reader->filled == reader->options.queue_depth && !reader->stop) {
+      pthread_cond_wait(&reader->cond, &reader->lock);
+    }
+    if (reader->stop) {
+      break;
+    }
+
+    json_reader_chunk_t *chunk = &reader->chunks[reader->tail];
+    pthread_mutex_unlock(&reader->lock);
+
+    // One read per chunk: full chunks for files, whatever is available for
+    // pipes, so the parser never waits on data that has already arrived.
+    ssize_t length = 0;
+    do {
+      length = read(reader->fd, chunk->data, reader->options.chunk_size);
+    } while (length < 0 && errno == EINTR);
+
+    pthread_mutex_lock(&reader->lock);
+    if (length > 0) {
+      chunk->length = length;
+      chunk->data[length] = '\0';
+      reader->tail = (reader->tail + 1) % reader->options.queue_depth;
+      reader->filled += 1;
+    } else {
+      reader->error = length < 0 ? IO_ERROR : 0;
+      reader->done = 1;
+    }
+    pthread_cond_broadcast(&reader->cond);
+
+    if (reader->done) {
+      break;
+    }
+  }
+  pthread_mutex_unlock(&reader->lock);
+
+  return NULL;
+}
+
+json_reader_t *json_reader_open(int fd, json_reader_options_t options) {
+  if (options.chunk_size == 0 || options.queue_depth < 2) {
+    return NULL;
+  }
+
+  json_reader_t *reader = calloc(1, sizeof(json_reader_t));
+  reader->fd = fd;
+  reader->options = options;
+  reader->chunks = calloc(options.queue_depth, sizeof(json_reader_chunk_t));
+  for (int idx = 0; idx < options.queue_depth; idx++) {
+    // One extra byte for a terminator, so values can be parsed in place.
+    reader->chunks[idx].data = malloc(options.chunk_size + 1);
+  }
+
+  pthread_mutex_init(&reader->lock, NULL);
+  pthread_cond_init(&reader->cond, NULL);
+
+  if (pthread_create(&reader->thread, NULL, json_reader_fill, reader) != 0) {
+    reader->stop = 1;
+    reader->thread = pthread_self();
+    json_reader_close(reader);
+    return NULL;
+  }
+
+  return reader;
+}
+
+void json_reader_close(json_reader_t *reader) {
+  pthread_mutex_lock(&reader->lock);
+  reader->stop = 1;
+  pthread_cond_broadcast(&reader->cond);
+  pthread_mutex_unlock(&reader->lock);
+
+  if (!pthread_equal(reader->thread, pthread_self())) {
+    pthread_join(reader->thread, NULL);
+  }
+
+  pthread_mutex_destroy(&reader->lock);
+  pthread_cond_destroy(&reader->cond);
+
+  for (int idx = 0; idx < reader->options.queue_depth; idx++) {
+    free(reader->chunks[idx].data);
+  }
+  free(reader->chunks);
+  free(reader->value);
+  free(reader);
+}
+
+/* Parsing side */
+
+/**
+ * Hands the current chunk back to the reading thread and waits for the next
+ * one.
+ */
+int json_reader_advance(json_reader_t *reader) {
+  int error = 0;
+
+  pthread_mutex_lock(&reader->lock);
+  if (reader->current != NULL) {
+    reader->head = (reader->head + 1) % reader->options.queue_depth;
+    reader->filled -= 1;
+    reader->current = NULL;
+    pthread_cond_broadcast(&reader->cond);
+  }
+
+  while (reader->filled == 0 && !reader->done) {
+    pthread_cond_wait(&reader->cond, &reader->lock);
+  }
+
+  if (reader->filled > 0) {
+    reader->current = &reader->chunks[reader->head];
+    reader->position = 0;
+  } else {
+    error = reader->error != 0 ? reader->error : JSON_READER_END;
+  }
+  pthread_mutex_unlock(&reader->lock);
+
+  return error;
+}
+
+void json_reader_keep(json_reader_t *reader, const char *data, size_t length) {
+  if (reader->value_size + length + 1 > reader->value_capacity) {
+    size_t capacity = reader->value_capacity == 0 ? 4096 : reader->value_capacity;
+    while (reader->value_size + length + 1 > capacity) {
+      capacity *= 2;
+    }
+    reader->value = realloc(reader->value, capacity);
+    reader->value_capacity = capacity;
+  }
+
+  memcpy(reader->value + reader->value_size, data, length);
+  reader->value_size += length;
+  reader->value[reader->value_size] = '\0';
+}
+
+/**
+ * Scans the current chunk for the end of the value. Returns 1 once the
+ * value is complete, with the position just past it.
+ */
+int json_reader_scan(json_reader_t *reader, json_reader_scan_t *scan) {
+  const char *data = reader->current->data;
+  size_t position = reader->position, length = reader->current->length;
+
+  while (position < length) {
+    char symbol = data[position];
+
+    if (scan->in_string) {
+      if (scan->escape) {
+        scan->escape = 0;
+      } else if (symbol == '\\') {
+        scan->escape = 1;
+      } else if (symbol == '"') {
+        scan->in_string = 0;
+        if (scan->depth == 0) {
+          reader->position = position + 1;
+          return 1;
+        }
+      }
+    } else if (scan->scalar) {
+      if (is_delimiter(symbol)) {
+        reader->position = position;
+        return 1;
+      }
+    } else if (symbol == '"') {
+      scan->in_string = 1;
+    } else if (symbol == '{' || symbol == '[') {
+      scan->depth += 1;
+    } else if (symbol == '}' || symbol == ']') {
+      scan->depth -= 1;
+      if (scan->depth == 0) {
+        reader->position = position + 1;
+        return 1;
+      }
+    }
+
+    position += 1;
+  }
+
+  reader->position = position;
+  return 0;
+}
+
+/**
+ * Moves to the start of the next value, past whitespace and array
+ * punctuation. Returns 1 if there is a value to read.
+ */
+int json_reader_seek(json_reader_t *reader) {
+  const char *data = reader->current->data;
+  size_t length = reader->current->length;
+
+  while (reader->position < length) {
+    char symbol = data[reader->position];
+
+    if (is_whitespace(symbol)) {
+      reader->position += 1;
+    } else if (reader->state == READER_START) {
+      if (symbol == '[' && reader->options.unwrap_array) {
+        reader->state = READER_ARRAY;
+        reader->position += 1;
+      } else {
+        reader->state = READER_SEQUENCE;
+      }
+    } else if (reader->state == READER_ARRAY && symbol == ',') {
+      reader->position += 1;
+    } else if (reader->state == READER_ARRAY && symbol == ']') {
+      reader->state = READER_FINISHED;
+      reader->position += 1;
+      return 0;
+    } else {
+      return reader->state != READER_FINISHED;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Parses a complete value, checking the filters of element objects first.
+ */
+int json_reader_parse(const char *input, void *target, json_descriptor_t descriptor) {
+  int offset = 0;
+  return json_parse_element(input, &offset, target, descriptor);
+}
+
+int json_reader_next(json_reader_t *reader, void *target, json_descriptor_t descriptor) {
+  json_reader_scan_t scan = { 0 };
+  size_t start = 0;
+  int error = 0;
+
+  reader->value_size = 0;
+
+  while (reader->state != READER_FINISHED) {
+    if (reader->current == NULL || reader->position == reader->current->length) {
+      if (scan.started) {
+        // The value continues in the next chunk.
+        json_reader_keep(reader, reader->current->data + start, reader->position - start);
+        start = 0;
+      }
+
+      error = json_reader_advance(reader);
+      if (error == JSON_READER_END && scan.started && scan.scalar) {
+        // The end of input terminates a trailing scalar.
+        return json_reader_parse(reader->value, target, descriptor);
+      } else if (error == JSON_READER_END && scan.started) {
+        return BAD_FORMAT;
+      } else if (error != 0) {
+        return error;
+      }
+      continue;
+    }
+
+    if (!scan.started) {
+      if (!json_reader_seek(reader)) {
+        continue;
+      }
+
+      char symbol = reader->current->data[reader->position];
+      scan.started = 1;
+      scan.in_string = (symbol == '"');
+      scan.scalar = (symbol != '"' && symbol != '{' && symbol != '[');
+      scan.depth = (symbol == '{' || symbol == '[');
+      start = reader->position;
+      reader->position += 1;
+    }
+
+    if (scan.scalar || scan.in_string || scan.depth > 0) {
+      if (!json_reader_scan(reader, &scan)) {
+        continue;
+      }
+    }
+
+    if (reader->value_size == 0) {
+      // The whole value is in this chunk, and the parser stops at its end.
+      error = json_reader_parse(reader->current->data + start, target, descriptor);
+    } else {
+      json_reader_keep(reader, reader->current->data + start, reader->position - start);
+      error = json_reader_parse(reader->value, target, descriptor);
+    }
+
+    if (error != FILTERED_OUT) {
+      return error;
+    }
+
+    // The value didn't pass the filters: skip it and scan for the next one.
+    memset(&scan, 0, sizeof(scan));
+    reader->value_size = 0;
+  }
+
+  return JSON_READER_END;
+}
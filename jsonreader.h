@@ -0,0 +1,113 @@
+#ifndef _H_JSON_READER
+#define _H_JSON_READER
+
+#include <stddef.h>
+#include <pthread.h>
+
+#include "json.h"
+
+/**
+ * Streaming reader for large files and pipes.
+ *
+ * A background thread reads the input into a ring of chunks while the
+ * caller parses values out of the chunks that are already there, so disk
+ * and CPU work overlap. Values are found with a resumable scanner that
+ * carries its state across chunk boundaries; values that fit in a chunk are
+ * parsed in place, the rest are stitched together first.
+ *
+ * The input is either a top-level array, whose elements are returned one by
+ * one, or a sequence of whitespace-separated values, such as NDJSON. Objects
+ * that don't pass the filters of their descriptor are skipped.
+ *
+ * Only the top level is split: every value returned is held in memory whole
+ * while it is parsed. A single large document, such as {"data": [...]}, is
+ * copied into one buffer as big as its text, and should be written as a
+ * top-level array or as NDJSON to be streamed.
+ *
+ * Example usage:
+ *
+ * json_reader_t *reader = json_reader_open(fd, (json_reader_options_t)JSON_READER_DEFAULTS);
+ * myobj item = { 0 };
+ * while (json_reader_next(reader, &item, desc) == 0) {
+ *   ...
+ * }
+ * json_reader_close(reader);
+ */
+
+#define JSON_READER_END -1
+
+typedef struct {
+  size_t chunk_size;
+  int queue_depth;
+  int unwrap_array;
+} json_reader_options_t;
+
+#define JSON_READER_DEFAULTS { \
+.chunk_size = 1 << 20, \
+.queue_depth = 4, \
+.unwrap_array = 1 \
+}
+
+typedef struct {
+  char *data;
+  size_t length;
+} json_reader_chunk_t;
+
+typedef struct {
+  int fd;
+  json_reader_options_t options;
+
+  // Ring of chunks shared with the reading thread.
+  json_reader_chunk_t *chunks;
+  int head;
+  int tail;
+  int filled;
+  int done;
+  int stop;
+  int error;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+
+  // Parsing side.
+  json_reader_chunk_t *current;
+  size_t position;
+  int state;
+  char *value;
+  size_t value_size;
+  size_t value_capacity;
+} json_reader_t;
+
+/**
+ * Starts reading the file in the background.
+ *
+ * @param fd: File or pipe to read from. The reader doesn't close it.
+ * @param options: Size of each chunk, number of chunks in the ring, and
+ *   whether elements of a top-level array are returned one by one.
+ *
+ * @return A new reader, or NULL if the options are invalid or the reading
+ *   thread couldn't be started.
+ */
+json_reader_t *json_reader_open(int fd, json_reader_options_t options);
+
+/**
+ * Parses the next value into the target.
+ *
+ * @param reader: Reader to take the value from.
+ * @param target: Target to fill.
+ * @param descriptor: Descriptor of the target.
+ *
+ * @return 0 if a value was parsed, JSON_READER_END if there are no more
+ *   values, or an error code.
+ */
+int json_reader_next(json_reader_t *reader, void *target, json_descriptor_t descriptor);
+
+/**
+ * Stops the reading thread and frees the reader. Waits for a pending read
+ * to return.
+ *
+ * @param reader: Reader to deallocate.
+ */
+void json_reader_close(json_reader_t *reader);
+
+#endif
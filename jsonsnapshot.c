@@ -0,0 +1,413 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "json.h"
+#include "jsonsnapshot.h"
+#include "jsoninternal.h"
+#include "genericlist.h"
+
+#define JSON_SNAPSHOT_MAGIC "CJSNAP2"
+#define JSON_SNAPSHOT_ROOT 64
+#define JSON_SNAPSHOT_ALIGN 16
+
+typedef struct {
+  char magic[8];
+  uint64_t key;
+  uint64_t descriptor_hash;
+  uint64_t size;
+  uint64_t strings;
+} json_snapshot_header_t;
+
+typedef struct {
+  char *data;
+  size_t size;
+  size_t capacity;
+} json_snapshot_buffer_t;
+
+typedef struct {
+  const char *pointer;
+  size_t offset;
+} json_snapshot_interned_t;
+
+/**
+ * Strings are collected in their own region at the end of the image, which
+ * ends with a terminator, so loading can bound-check them without reading
+ * them. Interned strings are stored once per distinct pointer.
+ */
+typedef struct {
+  json_snapshot_buffer_t image;
+  json_snapshot_buffer_t strings;
+  json_snapshot_interned_t *interned;
+  size_t num_interned;
+  size_t interned_capacity;
+} json_snapshot_writer_t;
+
+typedef struct {
+  char *base;
+  size_t size;
+  char *strings;
+  size_t strings_size;
+} json_snapshot_image_t;
+
+/* Hashing */
+
+uint64_t json_snapshot_mix(uint64_t hash, uint64_t value) {
+  hash ^= value;
+  hash *= 0x100000001b3ULL;
+  return hash ^ (hash >> 29);
+}
+
+unsigned long long json_snapshot_key(const char *source, size_t length) {
+  uint64_t hash = 0xcbf29ce484222325ULL, word = 0;
+  size_t idx = 0;
+
+  for (; idx + 8 <= length; idx += 8) {
+    memcpy(&word, source + idx, sizeof(word));
+    hash = json_snapshot_mix(hash, word);
+  }
+
+  word = 0;
+  memcpy(&word, source + idx, length - idx);
+  hash = json_snapshot_mix(hash, word);
+
+  return json_snapshot_mix(hash, length);
+}
+
+uint64_t json_snapshot_string_hash(uint64_t hash, const char *value) {
+  if (value == NULL) {
+    return json_snapshot_mix(hash, 0);
+  }
+  return json_snapshot_mix(hash, json_snapshot_key(value, strlen(value)));
+}
+
+uint64_t json_snapshot_double_hash(uint64_t hash, double value) {
+  uint64_t bits = 0;
+  memcpy(&bits, &value, sizeof(bits));
+  return json_snapshot_mix(hash, bits);
+}
+
+uint64_t json_snapshot_descriptor_hash(uint64_t hash, json_descriptor_t desc) {
+  json_object_descriptor_t *obj_desc = NULL;
+  json_enum_descriptor_t *enum_desc = NULL;
+
+  hash = json_snapshot_mix(hash, desc.type);
+
+  switch (desc.type) {
+  case ARRAY:
+  case COLUMNS:
+    hash = json_snapshot_descriptor_hash(hash, *(json_descriptor_t *)desc.descriptor);
+    break;
+  case OBJECT:
+    obj_desc = desc.descriptor;
+    hash = json_snapshot_mix(hash, obj_desc->size);
+    for (int idx = 0; idx < obj_desc->num_props; idx++) {
+      json_property_descriptor_t *prop = &obj_desc->props[idx];
+      hash = json_snapshot_string_hash(hash, prop->name);
+      hash = json_snapshot_mix(hash, prop->offset);
+      hash = json_snapshot_descriptor_hash(hash, prop->descriptor);
+    }
+    for (int idx = 0; idx < obj_desc->num_filters; idx++) {
+      json_filter_t *filter = &obj_desc->filters[idx];
+      hash = json_snapshot_string_hash(hash, filter->name);
+      hash = json_snapshot_mix(hash, filter->type);
+      hash = json_snapshot_string_hash(hash, filter->string);
+      hash = json_snapshot_double_hash(hash, filter->min);
+      hash = json_snapshot_double_hash(hash, filter->max);
+    }
+    break;
+  case ENUM:
+    enum_desc = desc.descriptor;
+    for (int idx = 0; idx < enum_desc->num_values; idx++) {
+      hash = json_snapshot_string_hash(hash, enum_desc->values[idx].name);
+      hash = json_snapshot_mix(hash, enum_desc->values[idx].value);
+    }
+    break;
+  }
+
+  return hash;
+}
+
+/* Writing */
+
+size_t json_snapshot_append(json_snapshot_buffer_t *buffer, const void *data, size_t length, size_t align) {
+  size_t offset = (buffer->size + align - 1) & ~(align - 1);
+
+  if (offset + length > buffer->capacity) {
+    size_t capacity = buffer->capacity == 0 ? 4096 : buffer->capacity;
+    while (offset + length > capacity) {
+      capacity *= 2;
+    }
+    buffer->data = realloc(buffer->data, capacity);
+    memset(buffer->data + buffer->capacity, 0, capacity - buffer->capacity);
+    buffer->capacity = capacity;
+  }
+
+  if (data != NULL) {
+    memcpy(buffer->data + offset, data, length);
+  }
+  buffer->size = offset + length;
+
+  return offset;
+}
+
+json_snapshot_interned_t *json_snapshot_interned_slot(json_snapshot_writer_t *writer, const char *pointer) {
+  if ((writer->num_interned + 1) * 2 > writer->interned_capacity) {
+    json_snapshot_interned_t *old = writer->interned;
+    size_t old_capacity = writer->interned_capacity;
+
+    writer->interned_capacity = old_capacity == 0 ? 64 : old_capacity * 2;
+    writer->interned = calloc(writer->interned_capacity, sizeof(json_snapshot_interned_t));
+    writer->num_interned = 0;
+
+    for (size_t idx = 0; idx < old_capacity; idx++) {
+      if (old[idx].pointer != NULL) {
+        *json_snapshot_interned_slot(writer, old[idx].pointer) = old[idx];
+        writer->num_interned += 1;
+      }
+    }
+    free(old);
+  }
+
+  size_t mask = writer->interned_capacity - 1;
+  size_t idx = (((uintptr_t)pointer >> 3) * 0x9E3779B97F4A7C15ULL >> 32) & mask;
+  while (writer->interned[idx].pointer != NULL && writer->interned[idx].pointer != pointer) {
+    idx = (idx + 1) & mask;
+  }
+
+  return &writer->interned[idx];
+}
+
+size_t json_snapshot_string(json_snapshot_writer_t *writer, const char *string, int interned) {
+  json_snapshot_interned_t *slot = NULL;
+
+  if (interned) {
+    slot = json_snapshot_interned_slot(writer, string);
+    if (slot->pointer != NULL) {
+      return slot->offset;
+    }
+  }
+
+  size_t offset = json_snapshot_append(&writer->strings, string, strlen(string) + 1, 1);
+
+  if (slot != NULL) {
+    slot->pointer = string;
+    slot->offset = offset;
+    writer->num_interned += 1;
+  }
+
+  return offset;
+}
+
+/**
+ * Copies everything the value at the given image offset points to into the
+ * image, and replaces the pointers with offsets. String offsets are relative
+ * to the string region.
+ */
+void json_snapshot_store(json_snapshot_writer_t *writer, size_t at, json_descriptor_t desc) {
+  json_snapshot_buffer_t *buffer = &writer->image;
+  json_object_descriptor_t *obj_desc = NULL;
+  json_descriptor_t *element_desc = NULL;
+  char *string = NULL;
+  list_t list = { 0 };
+  uintptr_t offset = 0;
+
+  switch (desc.type) {
+  case STRING:
+  case STRING_INTERNED:
+    memcpy(&string, buffer->data + at, sizeof(string));
+    if (string != NULL) {
+      offset = json_snapshot_string(writer, string, desc.type == STRING_INTERNED);
+    }
+    memcpy(buffer->data + at, &offset, sizeof(offset));
+    break;
+  case ARRAY:
+    element_desc = desc.descriptor;
+    memcpy(&list, buffer->data + at, sizeof(list));
+    if (list.items != NULL && list.size > 0) {
+      size_t element_size = json_element_size(*element_desc);
+      offset = json_snapshot_append(buffer, list.items, list.size * element_size, JSON_SNAPSHOT_ALIGN);
+      for (size_t idx = 0; idx < list.size; idx++) {
+        json_snapshot_store(writer, offset + idx * element_size, *element_desc);
+      }
+    }
+    list.items = (void *)offset;
+    memcpy(buffer->data + at, &list, sizeof(list));
+    break;
+  case COLUMNS:
+    obj_desc = ((json_descriptor_t *)desc.descriptor)->descriptor;
+    for (int idx = 0; idx < obj_desc->num_props; idx++) {
+      json_property_descriptor_t *prop = &obj_desc->props[idx];
+      json_descriptor_t column_desc = { .type = ARRAY, .descriptor = &prop->descriptor };
+      json_snapshot_store(writer, at + prop->offset, column_desc);
+    }
+    break;
+  case OBJECT:
+    obj_desc = desc.descriptor;
+    for (int idx = 0; idx < obj_desc->num_props; idx++) {
+      json_snapshot_store(writer, at + obj_desc->props[idx].offset, obj_desc->props[idx].descriptor);
+    }
+    break;
+  }
+}
+
+int json_snapshot_write(const void *target, json_descriptor_t descriptor, unsigned long long key, int fd) {
+  json_snapshot_writer_t writer = { 0 };
+  json_snapshot_buffer_t *buffer = &writer.image;
+  json_snapshot_header_t header = { .magic = JSON_SNAPSHOT_MAGIC };
+
+  // Offset 0 of the string region stands for NULL.
+  json_snapshot_append(&writer.strings, "", 1, 1);
+
+  json_snapshot_append(buffer, NULL, JSON_SNAPSHOT_ROOT, JSON_SNAPSHOT_ALIGN);
+  size_t root = json_snapshot_append(buffer, target, json_element_size(descriptor), JSON_SNAPSHOT_ALIGN);
+  json_snapshot_store(&writer, root, descriptor);
+
+  header.key = key;
+  header.descriptor_hash = json_snapshot_descriptor_hash(0xcbf29ce484222325ULL, descriptor);
+  header.strings = json_snapshot_append(buffer, writer.strings.data, writer.strings.size, JSON_SNAPSHOT_ALIGN);
+  header.size = buffer->size;
+  memcpy(buffer->data, &header, sizeof(header));
+
+  // The snapshot always starts at the beginning of the file, where loading
+  // looks for it. Appended writes ignore the offset, so they need an empty
+  // file.
+  int error = 0, flags = fcntl(fd, F_GETFL);
+  if (flags == -1 || ((flags & O_APPEND) && ftruncate(fd, 0) != 0)) {
+    error = IO_ERROR;
+  }
+
+  size_t written = 0;
+  while (written < buffer->size && error == 0) {
+    ssize_t result = pwrite(fd, buffer->data + written, buffer->size - written, written);
+    if (result > 0) {
+      written += result;
+    } else if (result < 0 && errno != EINTR) {
+      error = IO_ERROR;
+    }
+  }
+
+  // Drop the tail of a bigger snapshot that was there before.
+  if (error == 0 && ftruncate(fd, buffer->size) != 0) {
+    error = IO_ERROR;
+  }
+
+  free(buffer->data);
+  free(writer.strings.data);
+  free(writer.interned);
+  return error;
+}
+
+/* Loading */
+
+/**
+ * Turns the offsets stored in the value at the given address back into
+ * pointers into the mapped image.
+ */
+int json_snapshot_relocate(json_snapshot_image_t *image, void *value, json_descriptor_t desc) {
+  json_object_descriptor_t *obj_desc = NULL;
+  json_descriptor_t *element_desc = NULL;
+  list_t *list = NULL;
+  uintptr_t offset = 0;
+  int error = 0;
+
+  switch (desc.type) {
+  case STRING:
+  case STRING_INTERNED:
+    // The string region ends with a terminator, so any offset inside it is
+    // a valid string, and the string itself doesn't need to be read.
+    memcpy(&offset, value, sizeof(offset));
+    if (offset >= image->strings_size) {
+      return BAD_FORMAT;
+    }
+    *(char **)value = offset == 0 ? NULL : image->strings + offset;
+    break;
+  case ARRAY:
+    element_desc = desc.descriptor;
+    list = value;
+    offset = (uintptr_t)list->items;
+    if (offset == 0) {
+      // Only empty lists are stored without items.
+      if (list->size != 0) {
+        return BAD_FORMAT;
+      }
+      list->items = NULL;
+      break;
+    }
+
+    // Items are stored aligned, between the root and the string region.
+    size_t element_size = json_element_size(*element_desc), limit = image->strings - image->base;
+    if (offset % JSON_SNAPSHOT_ALIGN != 0 || offset < JSON_SNAPSHOT_ROOT || offset > limit
+        || element_size == 0 || list->size > (limit - offset) / element_size) {
+      return BAD_FORMAT;
+    }
+
+    list->items = image->base + offset;
+    for (size_t idx = 0; idx < list->size && error == 0; idx++) {
+      error = json_snapshot_relocate(image, list->items + idx * element_size, *element_desc);
+    }
+    break;
+  case COLUMNS:
+    obj_desc = ((json_descriptor_t *)desc.descriptor)->descriptor;
+    for (int idx = 0; idx < obj_desc->num_props && error == 0; idx++) {
+      json_property_descriptor_t *prop = &obj_desc->props[idx];
+      json_descriptor_t column_desc = { .type = ARRAY, .descriptor = &prop->descriptor };
+      error = json_snapshot_relocate(image, value + prop->offset, column_desc);
+    }
+    break;
+  case OBJECT:
+    obj_desc = desc.descriptor;
+    for (int idx = 0; idx < obj_desc->num_props && error == 0; idx++) {
+      error = json_snapshot_relocate(image, value + obj_desc->props[idx].offset, obj_desc->props[idx].descriptor);
+    }
+    break;
+  }
+
+  return error;
+}
+
+void *json_snapshot_load(int fd, json_descriptor_t descriptor, unsigned long long key) {
+  json_snapshot_header_t header;
+  struct stat info;
+
+  // Stale snapshots are rejected from the header alone, before mapping.
+  if (fstat(fd, &info) != 0 || pread(fd, &header, sizeof(header), 0) != sizeof(header)
+      || memcmp(header.magic, JSON_SNAPSHOT_MAGIC, sizeof(header.magic)) != 0
+      || header.key != key
+      || header.descriptor_hash != json_snapshot_descriptor_hash(0xcbf29ce484222325ULL, descriptor)
+      || header.size > (uint64_t)info.st_size
+      || header.strings < JSON_SNAPSHOT_ROOT + json_element_size(descriptor)
+      || header.strings >= header.size) {
+    return NULL;
+  }
+
+  json_snapshot_image_t image = { .size = header.size };
+  image.base = mmap(NULL, image.size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  if (image.base == MAP_FAILED) {
+    return NULL;
+  }
+  image.strings = image.base + header.strings;
+  image.strings_size = header.size - header.strings;
+
+  if (image.strings[image.strings_size - 1] != '\0'
+      || json_snapshot_relocate(&image, image.base + JSON_SNAPSHOT_ROOT, descriptor) != 0) {
+    munmap(image.base, image.size);
+    return NULL;
+  }
+
+  return image.base + JSON_SNAPSHOT_ROOT;
+}
+
+void json_snapshot_unload(void *target) {
+  if (target == NULL) {
+    return;
+  }
+
+  json_snapshot_header_t *header = target - JSON_SNAPSHOT_ROOT;
+  munmap(header, header->size);
+}
@@ -0,0 +1,79 @@
+#ifndef _H_JSON_SNAPSHOT
+#define _H_JSON_SNAPSHOT
+
+#include <stddef.h>
+
+#include "json.h"
+
+/**
+ * Binary snapshots of parsed data.
+ *
+ * A snapshot is a relocatable image of a parsed target: the target itself
+ * followed by every string and list it points to, with pointers stored as
+ * offsets into the image. Loading maps the file and turns the offsets back
+ * into pointers, so it costs page faults instead of a parse.
+ *
+ * Interned strings are stored once per distinct value and still share a
+ * pointer after loading.
+ *
+ * Each snapshot is keyed by a hash of the source JSON and of the descriptor,
+ * so a snapshot of an older source or made with a different descriptor is
+ * rejected on load. Only fields described by the descriptor are relocated.
+ *
+ * Example usage:
+ *
+ * unsigned long long key = json_snapshot_key(input, input_length);
+ * mylist *target = json_snapshot_load(fd, desc, key);
+ * if (target == NULL) {
+ *   target = calloc(1, sizeof(mylist));
+ *   json_parse(input, target, desc);
+ *   json_snapshot_write(target, desc, key, fd);
+ * }
+ */
+
+/**
+ * Hashes the source JSON to key a snapshot with.
+ *
+ * @param source: Source JSON.
+ * @param length: Length of the source.
+ *
+ * @return Key for json_snapshot_write and json_snapshot_load.
+ */
+unsigned long long json_snapshot_key(const char *source, size_t length);
+
+/**
+ * Writes a snapshot of a parsed target to a file.
+ *
+ * @param target: Target filled by json_parse.
+ * @param descriptor: Descriptor the target was parsed with.
+ * @param key: Key of the source the target was parsed from.
+ * @param fd: Regular file to write the snapshot to. Whatever the file held
+ *   before is replaced, the snapshot starts at its beginning, where
+ *   json_snapshot_load looks for it. Don't write over a snapshot that is
+ *   still loaded.
+ *
+ * @return 0 on success, or an error code.
+ */
+int json_snapshot_write(const void *target, json_descriptor_t descriptor, unsigned long long key, int fd);
+
+/**
+ * Maps a snapshot into memory.
+ *
+ * @param fd: File written by json_snapshot_write.
+ * @param descriptor: Descriptor the snapshot has to match.
+ * @param key: Key the snapshot has to match.
+ *
+ * @return Pointer to the restored target, or NULL if the snapshot is
+ *   missing, corrupt or stale. The target and everything it points to is
+ *   owned by the mapping and has to be released with json_snapshot_unload.
+ */
+void *json_snapshot_load(int fd, json_descriptor_t descriptor, unsigned long long key);
+
+/**
+ * Unmaps a snapshot.
+ *
+ * @param target: Target returned by json_snapshot_load.
+ */
+void json_snapshot_unload(void *target);
+
+#endif
@@ -22,6 +22,8 @@ void linked_list_free(linked_list_t *list) {
     }
     node = next;
   }
+
+  free(list);
 }
 
 int linked_list_size(linked_list_t *list) {
@@ -37,23 +39,13 @@ int linked_list_size(linked_list_t *list) {
 }
 
 linked_list_node_t *linked_list_tail(linked_list_t *list) {
-  linked_list_node_t *node = list->head;
-
-  if (node == NULL) {
-    return NULL; 
-  } else {
-    while (node->next != NULL) {
-      node = node->next;
-    }
-  }
-
-  return node;
+  return list->tail;
 }
 
 int linked_list_append(linked_list_t *list, void *value, void(*deinit)(void *)) {
   linked_list_node_t *tail = linked_list_tail(list);
 
-  linked_list_node_t *node = malloc(sizeof(linked_list_node_t *));
+  linked_list_node_t *node = malloc(sizeof(linked_list_node_t));
   node->value = value;
   node->deinit = deinit;
   node->next = NULL;
@@ -63,4 +55,5 @@ int linked_list_append(linked_list_t *list, void *value, void(*deinit)(void *))
   } else {
     list->head = node;
   }
+  list->tail = node;
 }
@@ -11,6 +11,7 @@ struct linked_list_node {
 
 typedef struct {
   linked_list_node_t *head;
+  linked_list_node_t *tail;
 } linked_list_t;
 
 linked_list_t *linked_list_new();
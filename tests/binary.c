@@ -0,0 +1,317 @@
+/**
+ * MessagePack and CBOR tests: the same records are encoded as MessagePack,
+ * CBOR and JSON text, decoded through one descriptor and compared, then the
+ * three decoders are timed against each other.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "../json.h"
+#include "../jsonbinary.h"
+#include "../genericlist.h"
+
+typedef struct {
+  int id;
+  double price;
+  char *name;
+  list_t tags;
+  int ok;
+} record_t;
+
+typedef struct {
+  unsigned char *data;
+  size_t size;
+  size_t capacity;
+} buffer_t;
+
+static int failures = 0;
+
+static void put(buffer_t *buffer, const void *data, size_t length) {
+  if (buffer->size + length > buffer->capacity) {
+    buffer->capacity = (buffer->size + length) * 2;
+    buffer->data = realloc(buffer->data, buffer->capacity);
+  }
+  memcpy(buffer->data + buffer->size, data, length);
+  buffer->size += length;
+}
+
+static void put_byte(buffer_t *buffer, unsigned char byte) {
+  put(buffer, &byte, 1);
+}
+
+static void put_be(buffer_t *buffer, uint64_t value, int bytes) {
+  for (int idx = bytes - 1; idx >= 0; idx--) {
+    put_byte(buffer, (value >> (idx * 8)) & 0xFF);
+  }
+}
+
+/* MessagePack */
+
+static void mp_header(buffer_t *buffer, unsigned char fix, unsigned char wide, size_t length) {
+  if (length < 16) {
+    put_byte(buffer, fix | length);
+  } else {
+    put_byte(buffer, wide);
+    put_be(buffer, length, 4);
+  }
+}
+
+static void mp_string(buffer_t *buffer, const char *value) {
+  size_t length = strlen(value);
+  if (length < 32) {
+    put_byte(buffer, 0xA0 | length);
+  } else {
+    put_byte(buffer, 0xDB);
+    put_be(buffer, length, 4);
+  }
+  put(buffer, value, length);
+}
+
+static void mp_int(buffer_t *buffer, int value) {
+  if (value >= 0 && value < 128) {
+    put_byte(buffer, value);
+  } else {
+    put_byte(buffer, 0xD2);
+    put_be(buffer, (uint32_t)value, 4);
+  }
+}
+
+static void mp_double(buffer_t *buffer, double value) {
+  uint64_t bits = 0;
+  memcpy(&bits, &value, sizeof(bits));
+  put_byte(buffer, 0xCB);
+  put_be(buffer, bits, 8);
+}
+
+/* CBOR */
+
+static void cbor_header(buffer_t *buffer, int major, uint64_t value) {
+  if (value < 24) {
+    put_byte(buffer, (major << 5) | value);
+  } else if (value < 256) {
+    put_byte(buffer, (major << 5) | 24);
+    put_be(buffer, value, 1);
+  } else if (value < 65536) {
+    put_byte(buffer, (major << 5) | 25);
+    put_be(buffer, value, 2);
+  } else {
+    put_byte(buffer, (major << 5) | 26);
+    put_be(buffer, value, 4);
+  }
+}
+
+static void cbor_string(buffer_t *buffer, const char *value) {
+  cbor_header(buffer, 3, strlen(value));
+  put(buffer, value, strlen(value));
+}
+
+static void cbor_int(buffer_t *buffer, int value) {
+  if (value >= 0) {
+    cbor_header(buffer, 0, value);
+  } else {
+    cbor_header(buffer, 1, -1 - (int64_t)value);
+  }
+}
+
+static void cbor_double(buffer_t *buffer, double value) {
+  uint64_t bits = 0;
+  memcpy(&bits, &value, sizeof(bits));
+  put_byte(buffer, 0xFB);
+  put_be(buffer, bits, 8);
+}
+
+/* Records */
+
+static void encode(int count, buffer_t *msgpack, buffer_t *cbor, buffer_t *text) {
+  char name[32], line[128];
+
+  mp_header(msgpack, 0x90, 0xDD, count);
+  cbor_header(cbor, 4, count);
+  put(text, "[", 1);
+
+  for (int idx = 0; idx < count; idx++) {
+    double price = idx * 0.25 - 100;
+    snprintf(name, sizeof(name), "item%d", idx);
+
+    mp_header(msgpack, 0x80, 0xDF, 6);
+    mp_string(msgpack, "id");
+    mp_int(msgpack, idx - 1000);
+    mp_string(msgpack, "price");
+    mp_double(msgpack, price);
+    mp_string(msgpack, "name");
+    mp_string(msgpack, name);
+    mp_string(msgpack, "tags");
+    mp_header(msgpack, 0x90, 0xDD, 2);
+    mp_string(msgpack, "new");
+    mp_string(msgpack, idx % 2 ? "odd" : "even");
+    mp_string(msgpack, "ok");
+    put_byte(msgpack, idx % 3 ? 0xC3 : 0xC2);
+    mp_string(msgpack, "extra");
+    put_byte(msgpack, 0xC0);
+
+    cbor_header(cbor, 5, 6);
+    cbor_string(cbor, "id");
+    cbor_int(cbor, idx - 1000);
+    cbor_string(cbor, "price");
+    cbor_double(cbor, price);
+    cbor_string(cbor, "name");
+    cbor_string(cbor, name);
+    cbor_string(cbor, "tags");
+    cbor_header(cbor, 4, 2);
+    cbor_string(cbor, "new");
+    cbor_string(cbor, idx % 2 ? "odd" : "even");
+    cbor_string(cbor, "ok");
+    put_byte(cbor, idx % 3 ? 0xF5 : 0xF4);
+    cbor_string(cbor, "extra");
+    put_byte(cbor, 0xF6);
+
+    int length = snprintf(line, sizeof(line),
+      "%s{\"id\":%d,\"price\":%.17g,\"name\":\"%s\",\"tags\":[\"new\",\"%s\"],\"ok\":%s,\"extra\":[]}",
+      idx > 0 ? "," : "", idx - 1000, price, name, idx % 2 ? "odd" : "even", idx % 3 ? "true" : "false");
+    put(text, line, length);
+  }
+
+  put(text, "]", 2);
+}
+
+static void free_records(list_t *list) {
+  record_t *records = list->items;
+  for (size_t idx = 0; idx < list->size; idx++) {
+    free(records[idx].name);
+    char **tags = records[idx].tags.items;
+    for (size_t tag = 0; tag < records[idx].tags.size; tag++) {
+      free(tags[tag]);
+    }
+    free(tags);
+  }
+  free(list->items);
+  list->items = NULL;
+  list->size = 0;
+}
+
+static void compare(const char *format, list_t *list, int count) {
+  record_t *records = list->items;
+  char name[32];
+
+  if (list->size != (size_t)count) {
+    printf("FAIL %s: %zu records instead of %d\n", format, list->size, count);
+    failures += 1;
+    return;
+  }
+
+  for (int idx = 0; idx < count; idx++) {
+    record_t *record = &records[idx];
+    char **tags = record->tags.items;
+    snprintf(name, sizeof(name), "item%d", idx);
+
+    if (record->id != idx - 1000 || record->price != idx * 0.25 - 100 || strcmp(record->name, name) != 0
+        || record->tags.size != 2 || strcmp(tags[1], idx % 2 ? "odd" : "even") != 0
+        || record->ok != (idx % 3 != 0)) {
+      printf("FAIL %s: record %d differs\n", format, idx);
+      failures += 1;
+      return;
+    }
+  }
+}
+
+static void check_errors(json_descriptor_t desc) {
+  json_descriptor_t strings = JSON_ARRAY JSON_STRING JSON_ARRAY_END;
+  list_t list = { 0 };
+
+  // ["abc", 5] into an array of strings: the decoded "abc" must be freed.
+  const unsigned char msgpack[] = { 0x92, 0xA3, 'a', 'b', 'c', 0x05 };
+  const unsigned char cbor[] = { 0x82, 0x63, 'a', 'b', 'c', 0x05 };
+  if (json_parse_msgpack(msgpack, sizeof(msgpack), &list, strings) == 0
+      || json_parse_cbor(cbor, sizeof(cbor), &list, strings) == 0) {
+    printf("FAIL mixed array decoded without an error\n");
+    failures += 1;
+  }
+
+  // Every truncation of a valid input fails cleanly.
+  buffer_t msgpack_records = { 0 }, cbor_records = { 0 }, text = { 0 };
+  encode(3, &msgpack_records, &cbor_records, &text);
+  for (size_t length = 0; length < msgpack_records.size; length++) {
+    if (json_parse_msgpack(msgpack_records.data, length, &list, desc) == 0) {
+      printf("FAIL truncated MessagePack at %zu decoded\n", length);
+      failures += 1;
+    }
+  }
+  for (size_t length = 0; length < cbor_records.size; length++) {
+    if (json_parse_cbor(cbor_records.data, length, &list, desc) == 0) {
+      printf("FAIL truncated CBOR at %zu decoded\n", length);
+      failures += 1;
+    }
+  }
+
+  free(msgpack_records.data);
+  free(cbor_records.data);
+  free(text.data);
+}
+
+static double seconds_since(struct timespec *start) {
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(int argc, char **argv) {
+  json_descriptor_t tags = JSON_ARRAY JSON_STRING JSON_ARRAY_END;
+  json_descriptor_t desc =
+  JSON_ARRAY
+    JSON_OBJECT(NULL, free, sizeof(record_t), 5)
+      JSON_PROPERTY(id, JSON_INT, offsetof(record_t, id)),
+      JSON_PROPERTY(price, JSON_FLOAT, offsetof(record_t, price)),
+      JSON_PROPERTY(name, JSON_STRING, offsetof(record_t, name)),
+      JSON_PROPERTY(tags, tags, offsetof(record_t, tags)),
+      JSON_PROPERTY(ok, JSON_BOOL, offsetof(record_t, ok))
+    JSON_OBJECT_END
+  JSON_ARRAY_END;
+
+  int count = 300000;
+  buffer_t msgpack = { 0 }, cbor = { 0 }, text = { 0 };
+  encode(count, &msgpack, &cbor, &text);
+
+  check_errors(desc);
+
+  const char *formats[] = { "JSON text", "MessagePack", "CBOR" };
+  size_t sizes[] = { text.size - 1, msgpack.size, cbor.size };
+
+  for (int format = 0; format < 3; format++) {
+    list_t list = { 0 };
+    struct timespec start;
+    int error = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (format == 0) {
+      error = json_parse((const char *)text.data, &list, desc);
+    } else if (format == 1) {
+      error = json_parse_msgpack(msgpack.data, msgpack.size, &list, desc);
+    } else {
+      error = json_parse_cbor(cbor.data, cbor.size, &list, desc);
+    }
+    double seconds = seconds_since(&start);
+
+    if (error != 0) {
+      printf("FAIL %s: error %d\n", formats[format], error);
+      failures += 1;
+    } else {
+      compare(formats[format], &list, count);
+    }
+    printf("%s: %zu bytes, %.1f MB/s, %.2f M records/s\n", formats[format], sizes[format],
+      sizes[format] / seconds / 1e6, count / seconds / 1e6);
+
+    free_records(&list);
+  }
+
+  free(msgpack.data);
+  free(cbor.data);
+  free(text.data);
+
+  printf("binary: %d failed\n", failures);
+  return failures == 0 ? 0 : 1;
+}
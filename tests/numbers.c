@@ -0,0 +1,258 @@
+/**
+ * Number conversion tests: every generated number is parsed with json_parse
+ * and compared bit for bit against strtod_l in the C locale, integers are
+ * compared against strtoll with their overflow boundaries, then numeric
+ * arrays are timed.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <locale.h>
+#include <time.h>
+
+#include "../json.h"
+#include "../jsoninternal.h"
+#include "../genericlist.h"
+
+static locale_t c_locale;
+static int failures = 0;
+static int checked = 0;
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t rng() {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return rng_state;
+}
+
+static void check(const char *text) {
+  double expected = strtod_l(text, NULL, c_locale), actual = 0;
+  int error = json_parse(text, &actual, (json_descriptor_t)JSON_FLOAT);
+
+  checked += 1;
+  if (error != 0 || memcmp(&expected, &actual, sizeof(double)) != 0) {
+    failures += 1;
+    if (failures <= 20) {
+      printf("FAIL %s: expected %.17g, got %.17g (error %d)\n", text, expected, actual, error);
+    }
+  }
+}
+
+static void check_corpus() {
+  static const char *hard[] = {
+    "0", "-0", "0.0", "1", "-1", "0.1", "0.2", "0.3", "1e23", "8.41e21",
+    "9007199254740992", "9007199254740993", "9007199254740995",
+    "18446744073709551615", "18446744073709551616",
+    "2.2250738585072011e-308", "2.2250738585072014e-308",
+    "4.9406564584124654e-324", "2.4703282292062327e-324",
+    "2.4703282292062328e-324", "1.7976931348623157e308",
+    "1.7976931348623158e308", "1.7976931348623159e308", "1e309", "1e-400",
+    "9.5e-325", "7.2057594037927933e16", "4.35679936e-8",
+    "9007199254740993.0000000000000001", "1.00000000000000011102230246251565404236316680908203125",
+    "1.00000000000000011102230246251565404236316680908203124",
+    "1.00000000000000011102230246251565404236316680908203126",
+    "0.000000000000000000000000000000000000000000000000000001",
+    "123456789012345678901234567890", "3.14159265358979323846264338327950288",
+    "1e0", "1E+2", "1e-2", "-1.5e-10", "5e-324", "0e1000", "1e22", "1e-22",
+    "4503599627370496.5", "4503599627370497.5", "2.5e-1", "1.7e-323",
+  };
+
+  for (size_t idx = 0; idx < sizeof(hard) / sizeof(hard[0]); idx++) {
+    check(hard[idx]);
+  }
+
+  char text[64];
+
+  // Round-trip output of random doubles, the usual serializer formats.
+  for (int idx = 0; idx < 500000; idx++) {
+    uint64_t bits = rng() & 0x7FFFFFFFFFFFFFFFULL;
+    double value = 0;
+    memcpy(&value, &bits, sizeof(double));
+    if (value != value || value > 1.7976931348623157e308) {
+      continue;
+    }
+    snprintf(text, sizeof(text), "%.17g", value);
+    check(text);
+    snprintf(text, sizeof(text), "%.15g", value);
+    check(text);
+  }
+
+  // Ordinary magnitudes.
+  for (int idx = 0; idx < 300000; idx++) {
+    double value = (double)(rng() % 100000000) / (double)(1 + rng() % 1000);
+    snprintf(text, sizeof(text), "%.17g", value);
+    check(text);
+    snprintf(text, sizeof(text), "%.6f", value);
+    check(text);
+    snprintf(text, sizeof(text), "%.3e", -value);
+    check(text);
+  }
+
+  // Random digit strings, including more than 19 digits and halfway cases.
+  for (int idx = 0; idx < 300000; idx++) {
+    int length = 1 + rng() % 24, point = rng() % (length + 1), position = 0;
+    for (int digit = 0; digit < length; digit++) {
+      if (digit == point && digit > 0) {
+        text[position++] = '.';
+      }
+      text[position++] = '0' + rng() % 10;
+    }
+    position += snprintf(text + position, sizeof(text) - position, "e%d", (int)(rng() % 700) - 350);
+    check(text);
+  }
+}
+
+/* Integers */
+
+static void check_int(const char *text, int expected_error, int expected) {
+  int actual = 0;
+  int error = json_parse(text, &actual, (json_descriptor_t)JSON_INT);
+
+  checked += 1;
+  if (error != expected_error || (error == 0 && actual != expected)) {
+    failures += 1;
+    if (failures <= 20) {
+      printf("FAIL %s: expected %d (error %d), got %d (error %d)\n", text, expected, expected_error, actual, error);
+    }
+  }
+}
+
+/**
+ * Checks a digit string on its own and inside an array, which goes through
+ * the separate number array path, against strtoll.
+ */
+static void check_int_digits(const char *text) {
+  long long value = strtoll(text, NULL, 10);
+  int fits = value >= INT_MIN && value <= INT_MAX;
+  check_int(text, fits ? 0 : NUMBER_OVERFLOW, (int)value);
+
+  char array[96];
+  snprintf(array, sizeof(array), "[7, %s, 7]", text);
+  list_t list = { 0 };
+  int error = json_parse(array, &list, (json_descriptor_t)JSON_ARRAY JSON_INT JSON_ARRAY_END);
+
+  checked += 1;
+  int *items = list.items;
+  if (fits ? error != 0 || list.size != 3 || items[1] != (int)value : error != NUMBER_OVERFLOW) {
+    failures += 1;
+    if (failures <= 20) {
+      printf("FAIL %s: error %d\n", array, error);
+    }
+  }
+  free(list.items);
+}
+
+static void check_ints() {
+  check_int("0", 0, 0);
+  check_int("-0", 0, 0);
+  check_int("2147483647", 0, INT_MAX);
+  check_int("-2147483648", 0, INT_MIN);
+  check_int("2147483648", NUMBER_OVERFLOW, 0);
+  check_int("-2147483649", NUMBER_OVERFLOW, 0);
+  check_int("9999999999", NUMBER_OVERFLOW, 0);
+  check_int("10000000000", NUMBER_OVERFLOW, 0);
+  check_int("99999999999999999999999", NUMBER_OVERFLOW, 0);
+  check_int_digits("00000000000000000000000000000000000042");
+  check_int_digits("-0000000000000000000000000000002147483648");
+  check_int_digits("0000000000000000000000000000002147483648");
+  check_int_digits("-00000000000000000000");
+  check_int_digits("000000000000000000000000000000000000000000000000000000000000");
+  check_int(" 12 ", 0, 12);
+  check_int("-", BAD_FORMAT, 0);
+  check_int("12x", BAD_FORMAT, 0);
+  check_int("1.5", BAD_FORMAT, 0);
+
+  char text[32];
+
+  // Every length from 1 to 11 digits, around the 8 digit SWAR step and the
+  // int limits: all nines, a one followed by zeros, and random digits.
+  for (int length = 1; length <= 11; length++) {
+    for (int sign = 0; sign < 2; sign++) {
+      char *digits = text + sign;
+      text[0] = '-';
+
+      memset(digits, '9', length);
+      digits[length] = '\0';
+      check_int_digits(text);
+
+      memset(digits, '0', length);
+      digits[0] = '1';
+      check_int_digits(text);
+
+      for (int idx = 0; idx < 2000; idx++) {
+        for (int digit = 0; digit < length; digit++) {
+          digits[digit] = '0' + rng() % 10;
+        }
+        check_int_digits(text);
+      }
+    }
+  }
+
+  // Everything close to the limits.
+  for (long long value = INT_MAX - 1000LL; value <= INT_MAX + 1000LL; value++) {
+    snprintf(text, sizeof(text), "%lld", value);
+    check_int_digits(text);
+    snprintf(text, sizeof(text), "%lld", -value - 1);
+    check_int_digits(text);
+  }
+}
+
+static double bench(const char *format, int count) {
+  char *input = malloc((size_t)count * 32 + 3);
+  int position = sprintf(input, "[");
+  for (int idx = 0; idx < count; idx++) {
+    double value = (double)(rng() % 1000000000) / 997.0;
+    if (idx > 0) {
+      input[position++] = ',';
+    }
+    position += sprintf(input + position, format, value);
+  }
+  sprintf(input + position, "]");
+
+  json_descriptor_t desc = JSON_ARRAY JSON_FLOAT JSON_ARRAY_END;
+  list_t list = { 0 };
+  struct timespec start, end;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  int error = json_parse(input, &list, desc);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  if (error != 0 || list.size != (size_t)count) {
+    printf("FAIL benchmark parse: error %d, %zu values\n", error, list.size);
+    failures += 1;
+  }
+
+  free(list.items);
+  free(input);
+  return position / seconds / 1e6;
+}
+
+int main(int argc, char **argv) {
+  c_locale = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+
+  check_corpus();
+  check_ints();
+
+  // The conversion mustn't depend on the decimal separator of the locale.
+  if (setlocale(LC_NUMERIC, "de_DE.UTF-8") != NULL || setlocale(LC_NUMERIC, "fr_FR.UTF-8") != NULL) {
+    check_corpus();
+    setlocale(LC_NUMERIC, "C");
+  } else {
+    printf("no comma locale installed, skipping locale check\n");
+  }
+
+  printf("numbers: %d checked, %d failed\n", checked, failures);
+  printf("array of %%.17g: %.1f MB/s\n", bench("%.17g", 1000000));
+  printf("array of %%.6f: %.1f MB/s\n", bench("%.6f", 1000000));
+
+  freelocale(c_locale);
+  return failures == 0 ? 0 : 1;
+}
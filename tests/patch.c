@@ -0,0 +1,146 @@
+/**
+ * Patch tests: merge patches are applied to a parsed configuration and the
+ * result is compared with the expected one, written out as text. Covers
+ * nested merges, null, whole arrays, ignored keys and values that fail to
+ * parse. Run under a leak checker to see that replaced fields are freed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "../json.h"
+#include "../jsonpatch.h"
+#include "../jsoninternal.h"
+#include "../genericlist.h"
+
+static int failures = 0;
+
+typedef struct {
+  int min;
+  int max;
+} limits_t;
+
+typedef struct {
+  char *host;
+  int port;
+  limits_t limits;
+} server_t;
+
+typedef struct {
+  char *name;
+  server_t server;
+  list_t tags;
+  double ratio;
+  int debug;
+} config_t;
+
+static const char *document =
+  "{\"name\": \"main\", \"server\": {\"host\": \"localhost\", \"port\": 80,"
+  " \"limits\": {\"min\": 1, \"max\": 10}}, \"tags\": [\"a\", \"b\", \"c\"],"
+  " \"ratio\": 0.5, \"debug\": false}";
+
+static void describe(config_t *config, char *text, size_t size) {
+  int used = snprintf(text, size, "%s %s:%d %d-%d [",
+    config->name != NULL ? config->name : "-",
+    config->server.host != NULL ? config->server.host : "-", config->server.port,
+    config->server.limits.min, config->server.limits.max);
+
+  char **tags = config->tags.items;
+  for (size_t idx = 0; idx < config->tags.size && used < (int)size; idx++) {
+    used += snprintf(text + used, size - used, "%s%s", idx > 0 ? " " : "", tags[idx]);
+  }
+
+  if (used < (int)size) {
+    snprintf(text + used, size - used, "] %g %d", config->ratio, config->debug);
+  }
+}
+
+/**
+ * Parses the document, applies the patch, and checks the error code and the
+ * patched configuration.
+ */
+static void check(const char *name, json_descriptor_t desc, const char *patch, int expected_error, const char *expected) {
+  config_t config = { 0 };
+  char text[512];
+
+  if (json_parse(document, &config, desc) != 0) {
+    printf("FAIL %s: document didn't parse\n", name);
+    failures += 1;
+    return;
+  }
+
+  int error = json_apply_patch(&config, desc, patch);
+  describe(&config, text, sizeof(text));
+  if (error != expected_error || strcmp(text, expected) != 0) {
+    printf("FAIL %s: code %d, got \"%s\" instead of \"%s\"\n", name, error, text, expected);
+    failures += 1;
+  }
+
+  json_free_value(&config, desc);
+}
+
+int main(int argc, char **argv) {
+  json_descriptor_t tags = JSON_ARRAY JSON_STRING JSON_ARRAY_END;
+  json_descriptor_t limits =
+  JSON_OBJECT(NULL, NULL, sizeof(limits_t), 2)
+    JSON_PROPERTY(min, JSON_INT, offsetof(limits_t, min)),
+    JSON_PROPERTY(max, JSON_INT, offsetof(limits_t, max))
+  JSON_OBJECT_END;
+  json_descriptor_t server =
+  JSON_OBJECT(NULL, NULL, sizeof(server_t), 3)
+    JSON_PROPERTY(host, JSON_STRING, offsetof(server_t, host)),
+    JSON_PROPERTY(port, JSON_INT, offsetof(server_t, port)),
+    JSON_PROPERTY(limits, limits, offsetof(server_t, limits))
+  JSON_OBJECT_END;
+  json_descriptor_t desc =
+  JSON_OBJECT(NULL, NULL, sizeof(config_t), 5)
+    JSON_PROPERTY(name, JSON_STRING, offsetof(config_t, name)),
+    JSON_PROPERTY(server, server, offsetof(config_t, server)),
+    JSON_PROPERTY(tags, tags, offsetof(config_t, tags)),
+    JSON_PROPERTY(ratio, JSON_FLOAT, offsetof(config_t, ratio)),
+    JSON_PROPERTY(debug, JSON_BOOL, offsetof(config_t, debug))
+  JSON_OBJECT_END;
+
+  check("empty patch", desc, "{}", 0, "main localhost:80 1-10 [a b c] 0.5 0");
+
+  // Nested objects are merged, members the patch doesn't mention are kept.
+  check("nested merge", desc, "{\"server\": {\"port\": 8080}}", 0,
+    "main localhost:8080 1-10 [a b c] 0.5 0");
+  check("deeper merge", desc, "{\"server\": {\"limits\": {\"max\": 99}}, \"debug\": true}", 0,
+    "main localhost:80 1-99 [a b c] 0.5 1");
+  check("replaced string", desc, "{\"server\": {\"host\": \"example.com\"}, \"name\": \"other\"}", 0,
+    "other example.com:80 1-10 [a b c] 0.5 0");
+  check("escaped key", desc, "{\"na\\u006de\": \"escaped\"}", 0,
+    "escaped localhost:80 1-10 [a b c] 0.5 0");
+
+  // Null frees the field and resets it.
+  check("null string", desc, "{\"name\": null}", 0, "- localhost:80 1-10 [a b c] 0.5 0");
+  check("null object", desc, "{\"server\": null}", 0, "main -:0 0-0 [a b c] 0.5 0");
+  check("null array", desc, "{\"tags\": null, \"ratio\": null}", 0, "main localhost:80 1-10 [] 0 0");
+
+  // Arrays are replaced as a whole, never merged.
+  check("replaced array", desc, "{\"tags\": [\"z\"]}", 0, "main localhost:80 1-10 [z] 0.5 0");
+  check("longer array", desc, "{\"tags\": [\"w\", \"x\", \"y\", \"z\"]}", 0,
+    "main localhost:80 1-10 [w x y z] 0.5 0");
+  check("empty array", desc, "{\"tags\": []}", 0, "main localhost:80 1-10 [] 0.5 0");
+
+  check("unknown keys", desc, "{\"nope\": {\"a\": [1, {\"b\": null}]}, \"server\": {\"port\": 1, \"x\": 2}}", 0,
+    "main localhost:1 1-10 [a b c] 0.5 0");
+
+  // A value that fails to parse leaves its field as it was.
+  check("bad number", desc, "{\"server\": {\"port\": \"x\"}}", BAD_FORMAT,
+    "main localhost:80 1-10 [a b c] 0.5 0");
+  check("bad array element", desc, "{\"tags\": [\"y\", 1]}", BAD_FORMAT,
+    "main localhost:80 1-10 [a b c] 0.5 0");
+  check("unterminated string", desc, "{\"name\": \"oth", BAD_FORMAT,
+    "main localhost:80 1-10 [a b c] 0.5 0");
+  check("members before the error", desc, "{\"name\": \"other\", \"ratio\": [1]}", BAD_FORMAT,
+    "other localhost:80 1-10 [a b c] 0.5 0");
+  check("missing colon", desc, "{\"server\": {\"port\" 1}}", BAD_FORMAT,
+    "main localhost:80 1-10 [a b c] 0.5 0");
+
+  printf("patch: %d failed\n", failures);
+  return failures == 0 ? 0 : 1;
+}
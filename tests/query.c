@@ -0,0 +1,202 @@
+/**
+ * Query tests: paths are compiled and run over small documents, and the
+ * reported values are compared with the expected ones, in order. Also runs
+ * one compiled query from several threads at once.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "../json.h"
+#include "../jsonquery.h"
+
+static int failures = 0;
+
+typedef struct {
+  char text[1024];
+  int count;
+} matches_t;
+
+static void on_match(int path, const char *value, int length, void *context) {
+  matches_t *matches = context;
+  size_t used = strlen(matches->text);
+  snprintf(matches->text + used, sizeof(matches->text) - used, "%s%d=%.*s",
+    matches->count > 0 ? " " : "", path, length, value);
+  matches->count += 1;
+}
+
+/**
+ * Runs the paths over the input and checks the matches, written as
+ * "path=value" pairs in the order they were reported.
+ */
+static void check(const char *name, const char **paths, int num_paths, const char *input, const char *expected) {
+  json_query_t *query = json_query_compile(paths, num_paths);
+  if (query == NULL) {
+    printf("FAIL %s: didn't compile\n", name);
+    failures += 1;
+    return;
+  }
+
+  matches_t matches = { "", 0 };
+  int error = json_query_run(query, input, on_match, &matches);
+  if (error != 0 || strcmp(matches.text, expected) != 0) {
+    printf("FAIL %s: error %d, got \"%s\" instead of \"%s\"\n", name, error, matches.text, expected);
+    failures += 1;
+  }
+
+  json_query_free(query);
+}
+
+static const char *document =
+  "{\"meta\": {\"id\": 7, \"tags\": [\"a\", \"b\"]},"
+  " \"items\": [{\"name\": \"x\", \"price\": 1.5}, {\"name\": \"y\", \"price\": 2}, {\"name\": \"z\"}],"
+  " \"a/b\": 1, \"m~n\": 2, \"~1\": 3, \"\": 4}";
+
+static void check_paths() {
+  const char *wildcard[] = { "/items/*/price" };
+  check("wildcard key", wildcard, 1, document, "0=1.5 0=2");
+
+  const char *wildcard_index[] = { "/meta/*" };
+  check("wildcard index", wildcard_index, 1, document, "0=7 0=[\"a\", \"b\"]");
+
+  const char *index[] = { "/items/1/name", "/meta/tags/0" };
+  check("index", index, 2, document, "1=\"a\" 0=\"y\"");
+
+  const char *index_on_object[] = { "/meta/0" };
+  check("index on an object", index_on_object, 1, document, "");
+
+  const char *leading_zero[] = { "/items/01/name" };
+  check("index with a leading zero", leading_zero, 1, document, "");
+
+  const char *escapes[] = { "/a~1b", "/m~0n", "/~01" };
+  check("escapes", escapes, 3, document, "0=1 1=2 2=3");
+
+  const char *empty_key[] = { "/" };
+  check("empty key", empty_key, 1, document, "0=4");
+
+  const char *root[] = { "" };
+  check("root", root, 1, "[1, 2]", "0=[1, 2]");
+  check("root scalar", root, 1, " 42 ", "0=42");
+
+  const char *missing[] = { "/meta/missing", "/items/9/name", "/nothing/deeper" };
+  check("missing", missing, 3, document, "");
+
+  const char *shared[] = { "/meta/id", "/meta", "/meta/tags/1", "/items/*/name", "/items/0/name" };
+  check("shared prefix", shared, 5, document,
+    "0=7 2=\"b\" 1={\"id\": 7, \"tags\": [\"a\", \"b\"]} 3=\"x\" 4=\"x\" 3=\"y\" 3=\"z\"");
+
+  const char *duplicate[] = { "/meta/id", "/meta/id" };
+  check("same path twice", duplicate, 2, document, "0=7 1=7");
+
+  const char *escaped_key[] = { "/caf\xc3\xa9" };
+  check("escaped key in input", escaped_key, 1, "{\"caf\\u00e9\": true}", "0=true");
+}
+
+static void check_errors() {
+  const char *relative[] = { "meta/id" };
+  if (json_query_compile(relative, 1) != NULL) {
+    printf("FAIL a path without a leading slash compiled\n");
+    failures += 1;
+  }
+
+  const char *paths[] = { "/a/b" };
+  const char *inputs[] = { "{\"a\": {\"b\" 1}}", "{\"a\": [1, 2}", "{\"a\": {\"b\": \"x}}" };
+  json_query_t *query = json_query_compile(paths, 1);
+  for (int idx = 0; idx < 3; idx++) {
+    matches_t matches = { "", 0 };
+    if (json_query_run(query, inputs[idx], on_match, &matches) == 0) {
+      printf("FAIL %s ran without an error\n", inputs[idx]);
+      failures += 1;
+    }
+  }
+  json_query_free(query);
+}
+
+/* Threads */
+
+typedef struct {
+  unsigned long long digest;
+  int count;
+} digest_t;
+
+static void on_digest(int path, const char *value, int length, void *context) {
+  digest_t *digest = context;
+  digest->digest = digest->digest * 31 + path;
+  for (int idx = 0; idx < length; idx++) {
+    digest->digest = digest->digest * 31 + (unsigned char)value[idx];
+  }
+  digest->count += 1;
+}
+
+typedef struct {
+  json_query_t *query;
+  const char *input;
+  digest_t expected;
+  int mismatches;
+} worker_t;
+
+static void *run_worker(void *argument) {
+  worker_t *worker = argument;
+  for (int round = 0; round < 50; round++) {
+    digest_t digest = { 0, 0 };
+    int error = json_query_run(worker->query, worker->input, on_digest, &digest);
+    if (error != 0 || digest.digest != worker->expected.digest || digest.count != worker->expected.count) {
+      worker->mismatches += 1;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Runs one compiled query from several threads over a document big enough
+ * for the runs to overlap, and compares every run with a single threaded
+ * one.
+ */
+static void check_threads() {
+  const char *paths[] = { "/items/*/price", "/items/*/tags/*", "/items/*/meta/id", "/meta/id" };
+  json_query_t *query = json_query_compile(paths, 4);
+  int num_items = 5000;
+  char *input = malloc(num_items * 96 + 64);
+  int length = sprintf(input, "{\"items\": [");
+
+  for (int idx = 0; idx < num_items; idx++) {
+    length += sprintf(input + length, "%s{\"price\": %d, \"tags\": [%d, \"t\"], \"meta\": {\"id\": %d}}",
+      idx > 0 ? ", " : "", idx, idx % 7, idx * 3);
+  }
+  sprintf(input + length, "], \"meta\": {\"id\": 1}}");
+
+  digest_t expected = { 0, 0 };
+  json_query_run(query, input, on_digest, &expected);
+  if (expected.count != num_items * 4 + 1) {
+    printf("FAIL threads: %d matches instead of %d\n", expected.count, num_items * 4 + 1);
+    failures += 1;
+  }
+
+  pthread_t threads[4];
+  worker_t workers[4];
+  for (int idx = 0; idx < 4; idx++) {
+    workers[idx] = (worker_t){ query, input, expected, 0 };
+    pthread_create(&threads[idx], NULL, run_worker, &workers[idx]);
+  }
+  for (int idx = 0; idx < 4; idx++) {
+    pthread_join(threads[idx], NULL);
+    if (workers[idx].mismatches != 0) {
+      printf("FAIL thread %d: %d runs differ\n", idx, workers[idx].mismatches);
+      failures += 1;
+    }
+  }
+
+  json_query_free(query);
+  free(input);
+}
+
+int main(int argc, char **argv) {
+  check_paths();
+  check_errors();
+  check_threads();
+
+  printf("query: %d failed\n", failures);
+  return failures == 0 ? 0 : 1;
+}
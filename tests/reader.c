@@ -0,0 +1,180 @@
+/**
+ * Reader tests: inputs are streamed through a pipe in pieces of every size
+ * up to a few dozen bytes, with chunks just as small and a queue of two, so
+ * values, strings and escapes are split at every possible point. The values
+ * read are compared with the expected ones, in order.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "../json.h"
+#include "../jsonreader.h"
+#include "../jsoninternal.h"
+
+static int failures = 0;
+
+typedef struct {
+  char *t;
+  int n;
+  char *s;
+} item_t;
+
+typedef struct {
+  int fd;
+  const char *input;
+  size_t piece;
+} writer_t;
+
+/**
+ * Writes the input to the pipe a piece at a time, so the reader gets it in
+ * small and uneven reads.
+ */
+static void *write_input(void *arg) {
+  writer_t *writer = arg;
+  size_t length = strlen(writer->input);
+
+  for (size_t position = 0; position < length; position += writer->piece) {
+    size_t size = length - position < writer->piece ? length - position : writer->piece;
+    if (write(writer->fd, writer->input + position, size) != (ssize_t)size) {
+      break;
+    }
+  }
+  close(writer->fd);
+
+  return NULL;
+}
+
+/**
+ * Streams the input with every chunk size up to max_chunk, and checks the
+ * values read, written as text by format, and the final code of the reader.
+ */
+static void check(const char *name, const char *input, json_descriptor_t desc, void *target,
+    void (*format)(void *target, char *text, size_t size), const char *expected, int expected_end) {
+  for (size_t chunk = 1; chunk <= 40; chunk++) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+      printf("FAIL %s: no pipe\n", name);
+      failures += 1;
+      return;
+    }
+
+    pthread_t thread;
+    writer_t writer = { fds[1], input, chunk % 7 + 1 };
+    pthread_create(&thread, NULL, write_input, &writer);
+
+    json_reader_options_t options = JSON_READER_DEFAULTS;
+    options.chunk_size = chunk;
+    options.queue_depth = 2;
+    json_reader_t *reader = json_reader_open(fds[0], options);
+
+    char text[1024] = "";
+    int error = 0;
+    while ((error = json_reader_next(reader, target, desc)) == 0) {
+      size_t used = strlen(text);
+      if (used > 0 && used < sizeof(text) - 1) {
+        strcat(text, " ");
+        used += 1;
+      }
+      format(target, text + used, sizeof(text) - used);
+    }
+
+    json_reader_close(reader);
+    pthread_join(thread, NULL);
+    close(fds[0]);
+
+    if (error != expected_end || strcmp(text, expected) != 0) {
+      printf("FAIL %s, chunks of %zu: code %d, got \"%s\" instead of \"%s\"\n",
+        name, chunk, error, text, expected);
+      failures += 1;
+      return;
+    }
+  }
+}
+
+static void format_item(void *target, char *text, size_t size) {
+  item_t *item = target;
+  snprintf(text, size, "%s%d:%s", item->t, item->n, item->s);
+  free(item->t);
+  free(item->s);
+  *item = (item_t){ 0 };
+}
+
+static void format_int(void *target, char *text, size_t size) {
+  snprintf(text, size, "%d", *(int *)target);
+}
+
+static void format_string(void *target, char *text, size_t size) {
+  char **string = target;
+  snprintf(text, size, "%s", *string);
+  free(*string);
+  *string = NULL;
+}
+
+static void check_items() {
+  json_descriptor_t desc =
+  JSON_OBJECT(NULL, NULL, sizeof(item_t), 3)
+    JSON_PROPERTY(t, JSON_STRING, offsetof(item_t, t)),
+    JSON_PROPERTY(n, JSON_INT, offsetof(item_t, n)),
+    JSON_PROPERTY(s, JSON_STRING, offsetof(item_t, s))
+  JSON_OBJECT_END;
+  json_descriptor_t filtered =
+  JSON_OBJECT(NULL, NULL, sizeof(item_t), 3)
+    JSON_PROPERTY(t, JSON_STRING, offsetof(item_t, t)),
+    JSON_PROPERTY(n, JSON_INT, offsetof(item_t, n)),
+    JSON_PROPERTY(s, JSON_STRING, offsetof(item_t, s))
+  JSON_OBJECT_WHERE(1)
+    JSON_FILTER_EQUALS(t, "a")
+  JSON_OBJECT_END;
+  item_t item = { 0 };
+
+  const char *array =
+    " [ {\"t\": \"a\", \"n\": 1, \"s\": \"plain\"},\n"
+    "{\"t\": \"b\", \"n\": 22, \"s\": \"quote \\\" ]} inside\"},"
+    "{\"s\": \"[{[{\", \"t\": \"a\", \"n\": 333},"
+    "{\"t\": \"b\", \"n\": 4, \"s\": \"}]\"}, {\"t\": \"a\", \"n\": -5, \"s\": \"\\\\\"} ] ";
+  check("array", array, desc, &item, format_item,
+    "a1:plain b22:quote \" ]} inside a333:[{[{ b4:}] a-5:\\", JSON_READER_END);
+  check("filtered array", array, filtered, &item, format_item,
+    "a1:plain a333:[{[{ a-5:\\", JSON_READER_END);
+
+  const char *sequence =
+    "{\"t\": \"b\", \"n\": 1, \"s\": \"x\"}\n{\"t\": \"a\", \"n\": 2, \"s\": \"{\"}\n"
+    "{\"t\": \"b\", \"n\": 3, \"s\": \"\\\"\"}{\"t\": \"a\", \"n\": 4, \"s\": \"]\"}";
+  check("filtered sequence", sequence, filtered, &item, format_item,
+    "a2:{ a4:]", JSON_READER_END);
+
+  const char *filtered_out = "[{\"t\": \"b\", \"n\": 1, \"s\": \"x\"}, {\"t\": \"c\", \"n\": 2, \"s\": \"y\"}]";
+  check("everything filtered", filtered_out, filtered, &item, format_item, "", JSON_READER_END);
+
+  check("unterminated object", "[{\"t\": \"a\", \"n\": 1, \"s\": \"x}\"", desc, &item, format_item,
+    "", BAD_FORMAT);
+}
+
+static void check_scalars() {
+  json_descriptor_t int_desc = JSON_INT;
+  json_descriptor_t string_desc = JSON_STRING;
+  int number = 0;
+  char *string = NULL;
+
+  check("array of ints", "[1, 22,333 ,-4444]", int_desc, &number, format_int,
+    "1 22 333 -4444", JSON_READER_END);
+  check("trailing scalar", "1 22\n333\n\n-4444", int_desc, &number, format_int,
+    "1 22 333 -4444", JSON_READER_END);
+  check("strings", "\"a]\" \"b\\\"[\"\n\"{c}\"", string_desc, &string, format_string,
+    "a] b\"[ {c}", JSON_READER_END);
+  check("unterminated string", "\"a\" \"b", string_desc, &string, format_string,
+    "a", BAD_FORMAT);
+}
+
+int main(int argc, char **argv) {
+  check_items();
+  check_scalars();
+
+  printf("reader: %d failed\n", failures);
+  return failures == 0 ? 0 : 1;
+}
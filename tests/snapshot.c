@@ -0,0 +1,343 @@
+/**
+ * Snapshot tests: parsed data is written to a snapshot and loaded back, and
+ * everything reachable from the loaded target is compared with the parsed
+ * one. Stale keys and descriptors, truncated files and randomly corrupted
+ * images have to be rejected, or load into something that is safe to walk.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../json.h"
+#include "../jsonsnapshot.h"
+#include "../jsoninternal.h"
+#include "../interntable.h"
+#include "../genericlist.h"
+
+static int failures = 0;
+
+typedef struct {
+  int id;
+  double price;
+  char *name;
+  const char *kind;
+  list_t tags;
+  int status;
+} record_t;
+
+typedef struct {
+  list_t ids;
+  list_t names;
+} columns_t;
+
+static json_enum_value_t statuses[] = {
+  JSON_ENUM_VALUE("active", 1),
+  JSON_ENUM_VALUE("banned", 2)
+};
+
+/**
+ * Folds everything reachable from the value into a digest. Walking a loaded
+ * snapshot this way also touches every pointer in it.
+ */
+static uint64_t digest(uint64_t hash, const void *value, json_descriptor_t desc) {
+  json_object_descriptor_t *obj_desc = NULL;
+  const list_t *list = value;
+  const char *string = NULL;
+
+  hash = hash * 31 + desc.type;
+
+  switch (desc.type) {
+  case INT:
+  case BOOL:
+  case ENUM:
+    hash = hash * 31 + *(const int *)value;
+    break;
+  case FLOAT:
+    hash = hash * 31 + (uint64_t)(*(const double *)value * 1000);
+    break;
+  case STRING:
+  case STRING_INTERNED:
+    string = *(const char **)value;
+    for (; string != NULL && *string != '\0'; string++) {
+      hash = hash * 31 + (unsigned char)*string;
+    }
+    break;
+  case ARRAY:
+    hash = hash * 31 + list->size;
+    for (size_t idx = 0; idx < list->size; idx++) {
+      json_descriptor_t *element_desc = desc.descriptor;
+      hash = digest(hash, list->items + idx * json_element_size(*element_desc), *element_desc);
+    }
+    break;
+  case OBJECT:
+    obj_desc = desc.descriptor;
+    for (int idx = 0; idx < obj_desc->num_props; idx++) {
+      hash = digest(hash, value + obj_desc->props[idx].offset, obj_desc->props[idx].descriptor);
+    }
+    break;
+  case COLUMNS:
+    obj_desc = ((json_descriptor_t *)desc.descriptor)->descriptor;
+    for (int idx = 0; idx < obj_desc->num_props; idx++) {
+      json_property_descriptor_t *prop = &obj_desc->props[idx];
+      json_descriptor_t column_desc = { .type = ARRAY, .descriptor = &prop->descriptor };
+      hash = digest(hash, value + prop->offset, column_desc);
+    }
+    break;
+  }
+
+  return hash;
+}
+
+static char *make_input(int count) {
+  char *input = malloc(count * 160 + 16);
+  int length = sprintf(input, "[");
+
+  for (int idx = 0; idx < count; idx++) {
+    length += sprintf(input + length,
+      "%s{\"id\": %d, \"price\": %d.25, \"name\": \"item %d\", \"kind\": \"kind%d\", \"tags\": [%s], \"status\": \"%s\"}",
+      idx > 0 ? ", " : "", idx, idx, idx, idx % 5,
+      idx % 3 == 0 ? "" : idx % 3 == 1 ? "\"a\"" : "\"a\", \"bc\"",
+      idx % 4 == 0 ? "banned" : "active");
+  }
+  sprintf(input + length, "]");
+
+  return input;
+}
+
+static void fail(const char *message) {
+  printf("FAIL %s\n", message);
+  failures += 1;
+}
+
+/**
+ * Writes the target, loads it back from the file and compares the two.
+ * Returns the loaded target, or NULL if the check failed.
+ */
+static void *round_trip(const char *name, int fd, void *target, json_descriptor_t desc, unsigned long long key) {
+  if (json_snapshot_write(target, desc, key, fd) != 0) {
+    printf("FAIL %s: write failed\n", name);
+    failures += 1;
+    return NULL;
+  }
+
+  void *loaded = json_snapshot_load(fd, desc, key);
+  if (loaded == NULL) {
+    printf("FAIL %s: load failed\n", name);
+    failures += 1;
+  } else if (digest(0, loaded, desc) != digest(0, target, desc)) {
+    printf("FAIL %s: loaded data differs\n", name);
+    failures += 1;
+    json_snapshot_unload(loaded);
+    loaded = NULL;
+  }
+
+  return loaded;
+}
+
+static void check_round_trips(FILE *file) {
+  intern_table_t *table = intern_table_new();
+  json_descriptor_t tags = JSON_ARRAY JSON_STRING JSON_ARRAY_END;
+  json_descriptor_t kind = JSON_STRING_INTERNED(table);
+  json_descriptor_t status = JSON_ENUM(statuses);
+  json_descriptor_t desc =
+  JSON_ARRAY
+    JSON_OBJECT(NULL, free, sizeof(record_t), 6)
+      JSON_PROPERTY(id, JSON_INT, offsetof(record_t, id)),
+      JSON_PROPERTY(price, JSON_FLOAT, offsetof(record_t, price)),
+      JSON_PROPERTY(name, JSON_STRING, offsetof(record_t, name)),
+      JSON_PROPERTY(kind, kind, offsetof(record_t, kind)),
+      JSON_PROPERTY(tags, tags, offsetof(record_t, tags)),
+      JSON_PROPERTY(status, status, offsetof(record_t, status))
+    JSON_OBJECT_END
+  JSON_ARRAY_END;
+  json_descriptor_t columns_desc =
+  JSON_COLUMNAR_ARRAY
+    JSON_OBJECT(NULL, NULL, sizeof(columns_t), 2)
+      JSON_PROPERTY(id, JSON_INT, offsetof(columns_t, ids)),
+      JSON_PROPERTY(name, JSON_STRING, offsetof(columns_t, names))
+    JSON_OBJECT_END
+  JSON_ARRAY_END;
+
+  int fd = fileno(file);
+  char *big = make_input(2000), *small = make_input(10);
+  list_t big_list = { 0 }, small_list = { 0 }, empty_list = { 0 };
+  columns_t columns = { 0 };
+
+  json_parse(big, &big_list, desc);
+  json_parse(small, &small_list, desc);
+  json_parse("[]", &empty_list, desc);
+  json_parse(big, &columns, columns_desc);
+
+  unsigned long long key = json_snapshot_key(big, strlen(big));
+  list_t *loaded = round_trip("records", fd, &big_list, desc, key);
+  if (loaded != NULL) {
+    // Interned strings are stored once and still shared after loading.
+    record_t *records = loaded->items;
+    if (records[0].kind != records[5].kind || records[0].kind == records[1].kind) {
+      fail("interned strings aren't shared after loading");
+    }
+    json_snapshot_unload(loaded);
+  }
+
+  // Stale snapshots.
+  if (json_snapshot_load(fd, desc, key + 1) != NULL) {
+    fail("loaded with a different key");
+  }
+  if (json_snapshot_load(fd, columns_desc, key) != NULL) {
+    fail("loaded with a different descriptor");
+  }
+  json_descriptor_t changed =
+  JSON_ARRAY
+    JSON_OBJECT(NULL, free, sizeof(record_t), 1)
+      JSON_PROPERTY(id, JSON_INT, offsetof(record_t, price))
+    JSON_OBJECT_END
+  JSON_ARRAY_END;
+  if (json_snapshot_load(fd, changed, key) != NULL) {
+    fail("loaded with a different property offset");
+  }
+
+  // A smaller snapshot written over a bigger one.
+  unsigned long long small_key = json_snapshot_key(small, strlen(small));
+  loaded = round_trip("smaller snapshot over a bigger one", fd, &small_list, desc, small_key);
+  if (loaded != NULL) {
+    json_snapshot_unload(loaded);
+  }
+  if (lseek(fd, 0, SEEK_END) > 4096) {
+    fail("the bigger snapshot wasn't truncated");
+  }
+
+  // Writing from any file position, and through an appending descriptor.
+  ftruncate(fd, 0);
+  lseek(fd, 100, SEEK_SET);
+  loaded = round_trip("write from an offset", fd, &small_list, desc, small_key);
+  if (loaded != NULL) {
+    json_snapshot_unload(loaded);
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_APPEND);
+  loaded = round_trip("write through O_APPEND", fd, &big_list, desc, key);
+  if (loaded != NULL) {
+    json_snapshot_unload(loaded);
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_APPEND);
+
+  loaded = round_trip("empty list", fd, &empty_list, desc, 1);
+  if (loaded != NULL) {
+    json_snapshot_unload(loaded);
+  }
+
+  columns_t *loaded_columns = round_trip("columns", fd, &columns, columns_desc, key);
+  if (loaded_columns != NULL) {
+    json_snapshot_unload(loaded_columns);
+  }
+
+  // Truncated files.
+  json_snapshot_write(&big_list, desc, key, fd);
+  off_t size = lseek(fd, 0, SEEK_END);
+  off_t lengths[] = { size - 1, size / 2, 100, 40, 0 };
+  for (size_t idx = 0; idx < sizeof(lengths) / sizeof(lengths[0]); idx++) {
+    ftruncate(fd, lengths[idx]);
+    if (json_snapshot_load(fd, desc, key) != NULL) {
+      printf("FAIL loaded a snapshot truncated to %lld bytes\n", (long long)lengths[idx]);
+      failures += 1;
+    }
+  }
+
+  json_free_value(&big_list, desc);
+  json_free_value(&small_list, desc);
+  json_free_value(&columns, columns_desc);
+  intern_table_free(table);
+  free(big);
+  free(small);
+}
+
+/* Corruption */
+
+static uint64_t random_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t next_random() {
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 7;
+  random_state ^= random_state << 17;
+  return random_state;
+}
+
+/**
+ * Overwrites random bytes and words of a valid image, including the size
+ * and offset fields, and loads it. A corrupt image has to be rejected, or
+ * load into something whose every list and string can be walked.
+ */
+static void check_corruption(FILE *file) {
+  json_descriptor_t tags = JSON_ARRAY JSON_STRING JSON_ARRAY_END;
+  json_descriptor_t desc =
+  JSON_ARRAY
+    JSON_OBJECT(NULL, free, sizeof(record_t), 3)
+      JSON_PROPERTY(id, JSON_INT, offsetof(record_t, id)),
+      JSON_PROPERTY(name, JSON_STRING, offsetof(record_t, name)),
+      JSON_PROPERTY(tags, tags, offsetof(record_t, tags))
+    JSON_OBJECT_END
+  JSON_ARRAY_END;
+
+  int fd = fileno(file);
+  char *input = make_input(20);
+  list_t list = { 0 };
+  json_parse(input, &list, desc);
+
+  ftruncate(fd, 0);
+  json_snapshot_write(&list, desc, 7, fd);
+  size_t size = lseek(fd, 0, SEEK_END);
+  char *image = malloc(size), *copy = malloc(size);
+  pread(fd, image, size, 0);
+
+  int loaded = 0;
+  for (int round = 0; round < 20000; round++) {
+    memcpy(copy, image, size);
+
+    int changes = 1 + next_random() % 4;
+    for (int idx = 0; idx < changes; idx++) {
+      // Skip the header, which only ever makes the load fail.
+      size_t at = 40 + next_random() % (size - 40);
+      if (next_random() % 2 == 0) {
+        copy[at] = next_random();
+      } else {
+        at &= ~(size_t)7;
+        uint64_t word = next_random() % 3 == 0 ? next_random() : next_random() % (size * 2);
+        memcpy(copy + at, &word, at + 8 <= size ? 8 : size - at);
+      }
+    }
+
+    pwrite(fd, copy, size, 0);
+    list_t *target = json_snapshot_load(fd, desc, 7);
+    if (target != NULL) {
+      digest(0, target, desc);
+      json_snapshot_unload(target);
+      loaded += 1;
+    }
+  }
+
+  printf("corrupted images: %d of 20000 loaded and walked\n", loaded);
+
+  json_free_value(&list, desc);
+  free(input);
+  free(image);
+  free(copy);
+}
+
+int main(int argc, char **argv) {
+  FILE *file = tmpfile();
+  if (file == NULL) {
+    printf("FAIL no temporary file\n");
+    return 1;
+  }
+
+  check_round_trips(file);
+  check_corruption(file);
+  fclose(file);
+
+  printf("snapshot: %d failed\n", failures);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,411 @@
+/**
+ * UTF-8 tests: a conformance corpus of valid and malformed sequences, every
+ * 1 to 3 byte string and random mutations checked against a reference
+ * decoder, both validator paths, \u escape decoding, and validation
+ * throughput on ASCII, accented and CJK text.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "../json.h"
+#include "../jsoninternal.h"
+#include "../utf8.h"
+
+// Not in utf8.h, the validator picks one of them itself.
+int utf8_validate_scalar(const unsigned char *data, size_t length);
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_SSSE3 1
+int utf8_validate_ssse3(const unsigned char *data, size_t length);
+#endif
+
+static int failures = 0;
+
+/**
+ * Decodes code points one by one, straight from RFC 3629: the shortest
+ * form only, no surrogates, nothing above U+10FFFF.
+ */
+static int reference_validate(const unsigned char *data, size_t length) {
+  size_t index = 0;
+
+  while (index < length) {
+    unsigned char byte = data[index];
+    uint32_t code, min;
+    int count;
+
+    if (byte < 0x80) {
+      index += 1;
+      continue;
+    } else if ((byte & 0xe0) == 0xc0) {
+      code = byte & 0x1f;
+      count = 1;
+      min = 0x80;
+    } else if ((byte & 0xf0) == 0xe0) {
+      code = byte & 0x0f;
+      count = 2;
+      min = 0x800;
+    } else if ((byte & 0xf8) == 0xf0) {
+      code = byte & 0x07;
+      count = 3;
+      min = 0x10000;
+    } else {
+      return 0;
+    }
+
+    if (count > length - index - 1) {
+      return 0;
+    }
+    for (int idx = 1; idx <= count; idx++) {
+      if ((data[index + idx] & 0xc0) != 0x80) {
+        return 0;
+      }
+      code = (code << 6) | (data[index + idx] & 0x3f);
+    }
+    if (code < min || code > 0x10ffff || (code >= 0xd800 && code <= 0xdfff)) {
+      return 0;
+    }
+    index += count + 1;
+  }
+
+  return 1;
+}
+
+static void check(const char *name, const unsigned char *data, size_t length, int expected) {
+  int results[3] = {
+    utf8_validate((const char *)data, length),
+    utf8_validate_scalar(data, length),
+#if defined(HAVE_SSSE3)
+    __builtin_cpu_supports("ssse3") ? utf8_validate_ssse3(data, length) : expected,
+#else
+    expected,
+#endif
+  };
+  const char *paths[] = { "dispatch", "scalar", "ssse3" };
+
+  for (int idx = 0; idx < 3; idx++) {
+    if (results[idx] != expected) {
+      if (failures < 20) {
+        printf("FAIL %s (%zu bytes): %s path says %d\n", name, length, paths[idx], results[idx]);
+      }
+      failures += 1;
+    }
+  }
+}
+
+/* Conformance corpus */
+
+typedef struct {
+  const char *name;
+  const char *bytes;
+  int valid;
+} sample_t;
+
+static const sample_t corpus[] = {
+  { "empty", "", 1 },
+  { "ascii", "hello", 1 },
+  { "U+0080", "\xc2\x80", 1 },
+  { "U+07FF", "\xdf\xbf", 1 },
+  { "U+0800", "\xe0\xa0\x80", 1 },
+  { "U+D7FF", "\xed\x9f\xbf", 1 },
+  { "U+E000", "\xee\x80\x80", 1 },
+  { "U+FFFD", "\xef\xbf\xbd", 1 },
+  { "U+FFFF", "\xef\xbf\xbf", 1 },
+  { "U+10000", "\xf0\x90\x80\x80", 1 },
+  { "U+10FFFF", "\xf4\x8f\xbf\xbf", 1 },
+  { "mixed", "a\xc3\xa9\xe4\xb8\xad\xf0\x9f\x98\x80z", 1 },
+
+  { "lone continuation", "\x80", 0 },
+  { "lone continuation 0xbf", "\xbf", 0 },
+  { "continuation after ascii", "a\x80", 0 },
+  { "extra continuation", "\xc3\xa9\x80", 0 },
+  { "lead without continuation", "\xc3", 0 },
+  { "lead followed by ascii", "\xc3" "a", 0 },
+  { "lead followed by lead", "\xc3\xc3\xa9", 0 },
+  { "truncated 3 byte", "\xe4\xb8", 0 },
+  { "truncated 3 byte then ascii", "\xe4\xb8" "a", 0 },
+  { "truncated 4 byte", "\xf0\x9f\x98", 0 },
+  { "truncated 4 byte then ascii", "\xf0\x9f" "ab", 0 },
+  { "overlong NUL", "\xc0\x80", 0 },
+  { "overlong 2 byte 0xc1", "\xc1\xbf", 0 },
+  { "overlong 3 byte", "\xe0\x80\xaf", 0 },
+  { "overlong 3 byte max", "\xe0\x9f\xbf", 0 },
+  { "overlong 4 byte", "\xf0\x80\x80\xaf", 0 },
+  { "overlong 4 byte max", "\xf0\x8f\xbf\xbf", 0 },
+  { "high surrogate", "\xed\xa0\x80", 0 },
+  { "low surrogate", "\xed\xbf\xbf", 0 },
+  { "surrogate pair", "\xed\xa0\xbd\xed\xb8\x80", 0 },
+  { "U+110000", "\xf4\x90\x80\x80", 0 },
+  { "0xf5 lead", "\xf5\x80\x80\x80", 0 },
+  { "0xf7 lead", "\xf7\xbf\xbf\xbf", 0 },
+  { "5 byte lead", "\xf8\x88\x80\x80\x80", 0 },
+  { "6 byte lead", "\xfc\x84\x80\x80\x80\x80", 0 },
+  { "0xfe", "\xfe", 0 },
+  { "0xff", "\xff", 0 },
+};
+
+/**
+ * Every sample is checked on its own, and then at each offset of an ASCII
+ * and of a multibyte buffer, so it lands on every position of the vector
+ * blocks, including across block boundaries and in the scalar tail.
+ */
+static void check_corpus() {
+  size_t count = sizeof(corpus) / sizeof(corpus[0]);
+  unsigned char buffer[160];
+
+  for (size_t idx = 0; idx < count; idx++) {
+    const sample_t *sample = &corpus[idx];
+    size_t length = strlen(sample->bytes);
+
+    if (reference_validate((const unsigned char *)sample->bytes, length) != sample->valid) {
+      printf("FAIL reference disagrees on %s\n", sample->name);
+      failures += 1;
+    }
+    check(sample->name, (const unsigned char *)sample->bytes, length, sample->valid);
+
+    for (size_t offset = 0; offset < 70; offset++) {
+      // ASCII around the sample.
+      memset(buffer, 'x', sizeof(buffer));
+      memcpy(buffer + offset, sample->bytes, length);
+      check(sample->name, buffer, sizeof(buffer), sample->valid);
+      check(sample->name, buffer, offset + length, sample->valid);
+
+      // Two byte characters around the sample.
+      for (size_t pos = 0; pos + 1 < sizeof(buffer); pos += 2) {
+        buffer[pos] = 0xc3;
+        buffer[pos + 1] = 0xa9;
+      }
+      size_t start = offset & ~(size_t)1;
+      memcpy(buffer + start, sample->bytes, length);
+      if ((start + length) & 1) {
+        buffer[start + length] = 'x';
+      }
+      check(sample->name, buffer, sizeof(buffer), sample->valid);
+    }
+  }
+}
+
+/**
+ * Every 1, 2 and 3 byte string, once on its own and once straddling the
+ * boundary between two vector blocks.
+ */
+static void check_exhaustive() {
+  unsigned char buffer[48];
+
+  for (uint32_t value = 0; value < (1u << 24); value++) {
+    unsigned char bytes[3] = { value >> 16, value >> 8, value };
+    int length = value < 0x100 ? 1 : value < 0x10000 ? 2 : 3;
+    const unsigned char *data = bytes + 3 - length;
+    int expected = reference_validate(data, length);
+
+    int result = utf8_validate((const char *)data, length);
+    if (result != expected) {
+      if (failures < 20) {
+        printf("FAIL %06x alone: %d\n", value, result);
+      }
+      failures += 1;
+    }
+
+    memset(buffer, 'x', sizeof(buffer));
+    memcpy(buffer + 15, data, length);
+    result = utf8_validate((const char *)buffer, sizeof(buffer));
+    if (result != expected) {
+      if (failures < 20) {
+        printf("FAIL %06x at block boundary: %d\n", value, result);
+      }
+      failures += 1;
+    }
+  }
+}
+
+/* Random text */
+
+static uint64_t random_state = 0x9e3779b97f4a7c15ULL;
+
+static uint32_t next_random() {
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 7;
+  random_state ^= random_state << 17;
+  return random_state >> 32;
+}
+
+static size_t put_code(unsigned char *buffer, uint32_t code) {
+  if (code < 0x80) {
+    buffer[0] = code;
+    return 1;
+  } else if (code < 0x800) {
+    buffer[0] = 0xc0 | (code >> 6);
+    buffer[1] = 0x80 | (code & 0x3f);
+    return 2;
+  } else if (code < 0x10000) {
+    buffer[0] = 0xe0 | (code >> 12);
+    buffer[1] = 0x80 | ((code >> 6) & 0x3f);
+    buffer[2] = 0x80 | (code & 0x3f);
+    return 3;
+  }
+  buffer[0] = 0xf0 | (code >> 18);
+  buffer[1] = 0x80 | ((code >> 12) & 0x3f);
+  buffer[2] = 0x80 | ((code >> 6) & 0x3f);
+  buffer[3] = 0x80 | (code & 0x3f);
+  return 4;
+}
+
+static uint32_t random_code() {
+  switch (next_random() % 4) {
+  case 0:
+    return next_random() % 0x80;
+  case 1:
+    return 0x80 + next_random() % 0x780;
+  case 2: {
+    uint32_t code = 0x800 + next_random() % 0xf800;
+    return code >= 0xd800 && code <= 0xdfff ? 0xfffd : code;
+  }
+  default:
+    return 0x10000 + next_random() % 0x100000;
+  }
+}
+
+/**
+ * Valid random text, then the same text with a few bytes replaced,
+ * removed or cut off, compared against the reference decoder.
+ */
+static void check_random() {
+  unsigned char buffer[600];
+
+  for (int round = 0; round < 200000; round++) {
+    size_t length = 0;
+    size_t target = next_random() % 512;
+
+    while (length < target) {
+      length += put_code(buffer + length, random_code());
+    }
+    check("random text", buffer, length, 1);
+
+    int mutations = 1 + next_random() % 3;
+    for (int idx = 0; idx < mutations && length > 0; idx++) {
+      size_t pos = next_random() % length;
+      switch (next_random() % 3) {
+      case 0:
+        buffer[pos] = next_random();
+        break;
+      case 1:
+        memmove(buffer + pos, buffer + pos + 1, length - pos - 1);
+        length -= 1;
+        break;
+      default:
+        length = pos + 1;
+        break;
+      }
+    }
+    check("mutated text", buffer, length, reference_validate(buffer, length));
+  }
+}
+
+/* Escapes */
+
+static void check_escape(const char *input, const char *expected) {
+  char *target = NULL;
+  int error = json_parse(input, &target, (json_descriptor_t)JSON_STRING);
+
+  if (expected == NULL) {
+    if (error != BAD_FORMAT) {
+      printf("FAIL %s: error %d instead of BAD_FORMAT\n", input, error);
+      failures += 1;
+    }
+  } else if (error != 0 || strcmp(target, expected) != 0) {
+    printf("FAIL %s: error %d\n", input, error);
+    failures += 1;
+  }
+
+  if (error == 0) {
+    free(target);
+  }
+}
+
+static void check_escapes() {
+  check_escape("\"\\u0041\"", "A");
+  check_escape("\"\\u00e9t\\u00E9\"", "\xc3\xa9t\xc3\xa9");
+  check_escape("\"\\u4e2d\"", "\xe4\xb8\xad");
+  check_escape("\"\\ud83d\\ude00\"", "\xf0\x9f\x98\x80");
+  check_escape("\"\\udbff\\udfff\"", "\xf4\x8f\xbf\xbf");
+  check_escape("\"\\u0000\"", NULL);
+  check_escape("\"\\u0000x\"", NULL);
+  check_escape("\"\\ud83d\"", NULL);
+  check_escape("\"\\ud83dx\"", NULL);
+  check_escape("\"\\ude00\"", NULL);
+  check_escape("\"\\ud83d\\u0041\"", NULL);
+  check_escape("\"\\u12\"", NULL);
+  check_escape("\"\\u12g4\"", NULL);
+}
+
+/* Throughput */
+
+static double seconds_since(struct timespec *start) {
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void fill(unsigned char *buffer, size_t size, const char *text) {
+  size_t length = strlen(text);
+  size_t index = 0;
+
+  while (index + length <= size) {
+    memcpy(buffer + index, text, length);
+    index += length;
+  }
+  memset(buffer + index, ' ', size - index);
+}
+
+static void benchmark() {
+  const char *names[] = { "ASCII", "accented", "CJK" };
+  const char *texts[] = {
+    "The quick brown fox jumps over the lazy dog, again and again. ",
+    "L'\xc3\xa9l\xc3\xa8ve \xc3\xa0 la for\xc3\xaat, d\xc3\xa9j\xc3\xa0 tr\xc3\xa8s \xc3\xa9mu. ",
+    "\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e\xe3\x81\xae\xe6\x96\x87\xe7\xab\xa0\xe3\x80\x82"
+    "\xe4\xb8\xad\xe6\x96\x87\xe6\x96\x87\xe6\x9c\xac\xe3\x80\x82",
+  };
+  size_t size = 16 << 20;
+  unsigned char *buffer = malloc(size);
+
+  for (int text = 0; text < 3; text++) {
+    fill(buffer, size, texts[text]);
+    // Warm up, the first pass over the buffer is slower for either path.
+    utf8_validate_scalar(buffer, size);
+
+    for (int path = 0; path < 2; path++) {
+      struct timespec start;
+      int rounds = 20, valid = 1;
+
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      for (int round = 0; round < rounds; round++) {
+        valid &= path == 0
+          ? utf8_validate((const char *)buffer, size)
+          : utf8_validate_scalar(buffer, size);
+      }
+      double seconds = seconds_since(&start);
+
+      if (!valid) {
+        printf("FAIL %s text rejected\n", names[text]);
+        failures += 1;
+      }
+      printf("%s, %s: %.2f GB/s\n", names[text], path == 0 ? "utf8_validate" : "scalar",
+        (double)size * rounds / seconds / 1e9);
+    }
+  }
+
+  free(buffer);
+}
+
+int main(int argc, char **argv) {
+  check_corpus();
+  check_exhaustive();
+  check_random();
+  check_escapes();
+  benchmark();
+
+  printf("utf8: %d failed\n", failures);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,247 @@
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define UTF8_SSSE3 1
+#include <tmmintrin.h>
+#endif
+
+#include "utf8.h"
+
+/* Scalar validation */
+
+/**
+ * Skips the ASCII prefix of the data, returning the index of the first
+ * non-ASCII byte, or of a short tail that is left for the scalar loop.
+ */
+size_t utf8_skip_ascii(const unsigned char *data, size_t index, size_t length) {
+#if defined(__SSE2__)
+  while (index + 32 <= length) {
+    __m128i first = _mm_loadu_si128((const __m128i *)(data + index));
+    __m128i second = _mm_loadu_si128((const __m128i *)(data + index + 16));
+    if (_mm_movemask_epi8(_mm_or_si128(first, second)) != 0) {
+      break;
+    }
+    index += 32;
+  }
+#endif
+
+  while (index + 8 <= length) {
+    uint64_t word;
+    memcpy(&word, data + index, sizeof(word));
+    if ((word & 0x8080808080808080ULL) != 0) {
+      break;
+    }
+    index += 8;
+  }
+
+  return index;
+}
+
+int utf8_validate_scalar(const unsigned char *data, size_t length) {
+  size_t index = 0;
+
+  while (index < length) {
+    index = utf8_skip_ascii(data, index, length);
+
+    // Check sequences one by one until the next ASCII run.
+    size_t stop = index + 16 < length ? index + 16 : length;
+    while (index < stop) {
+      unsigned char byte = data[index];
+      unsigned char low = 0x80, high = 0xbf;
+      int continuation = 0;
+
+      if (byte < 0x80) {
+        index += 1;
+        continue;
+      } else if (byte >= 0xc2 && byte <= 0xdf) {
+        continuation = 1;
+      } else if (byte >= 0xe0 && byte <= 0xef) {
+        continuation = 2;
+        // No overlongs and no surrogates.
+        low = byte == 0xe0 ? 0xa0 : 0x80;
+        high = byte == 0xed ? 0x9f : 0xbf;
+      } else if (byte >= 0xf0 && byte <= 0xf4) {
+        continuation = 3;
+        // No overlongs and nothing above U+10FFFF.
+        low = byte == 0xf0 ? 0x90 : 0x80;
+        high = byte == 0xf4 ? 0x8f : 0xbf;
+      } else {
+        return 0;
+      }
+
+      if (continuation > length - index - 1) {
+        return 0;
+      }
+
+      // The second byte has the tightest range, the rest are plain
+      // continuation bytes.
+      if (data[index + 1] < low || data[index + 1] > high) {
+        return 0;
+      }
+      for (int idx = 2; idx <= continuation; idx++) {
+        if ((data[index + idx] & 0xc0) != 0x80) {
+          return 0;
+        }
+      }
+
+      index += continuation + 1;
+    }
+  }
+
+  return 1;
+}
+
+/* Vector validation */
+
+#if defined(UTF8_SSSE3)
+
+// Error classes of a pair of consecutive bytes, see utf8_check_block.
+#define UTF8_TOO_SHORT (1 << 0)
+#define UTF8_TOO_LONG (1 << 1)
+#define UTF8_OVERLONG_3 (1 << 2)
+#define UTF8_TOO_LARGE (1 << 3)
+#define UTF8_SURROGATE (1 << 4)
+#define UTF8_OVERLONG_2 (1 << 5)
+#define UTF8_TOO_LARGE_1000 (1 << 6)
+#define UTF8_OVERLONG_4 (1 << 6)
+#define UTF8_TWO_CONTS (1 << 7)
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+typedef struct {
+  __m128i previous;
+  __m128i incomplete;
+  __m128i error;
+} utf8_state_t;
+
+__attribute__((target("ssse3")))
+static inline __m128i utf8_high_nibbles(__m128i bytes) {
+  return _mm_and_si128(_mm_srli_epi16(bytes, 4), _mm_set1_epi8(0x0f));
+}
+
+/**
+ * Checks 16 bytes at once (Keiser and Lemire, "Validating UTF-8 In Less Than
+ * One Instruction Per Byte"). Every byte is classified together with the one
+ * before it through three 16-entry lookups, on the high and low nibble of
+ * the previous byte and the high nibble of the current one. A pair is
+ * invalid when all three lookups share an error bit. Whether a byte has to
+ * be the second or third continuation of a longer sequence is checked
+ * separately against the bytes two and three positions back.
+ */
+__attribute__((target("ssse3")))
+static inline void utf8_check_block(utf8_state_t *state, __m128i input) {
+  const __m128i byte_1_high_table = _mm_setr_epi8(
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+    UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+    UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+    UTF8_TOO_SHORT,
+    UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+    UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4);
+  const __m128i byte_1_low_table = _mm_setr_epi8(
+    UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+    UTF8_CARRY | UTF8_OVERLONG_2,
+    UTF8_CARRY,
+    UTF8_CARRY,
+    UTF8_CARRY | UTF8_TOO_LARGE,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000);
+  const __m128i byte_2_high_table = _mm_setr_epi8(
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT);
+
+  __m128i previous1 = _mm_alignr_epi8(input, state->previous, 15);
+  __m128i special = _mm_and_si128(
+    _mm_and_si128(
+      _mm_shuffle_epi8(byte_1_high_table, utf8_high_nibbles(previous1)),
+      _mm_shuffle_epi8(byte_1_low_table, _mm_and_si128(previous1, _mm_set1_epi8(0x0f)))),
+    _mm_shuffle_epi8(byte_2_high_table, utf8_high_nibbles(input)));
+
+  // Bytes after a 3 or 4 byte lead have to be continuations, which the
+  // lookups above mark as two continuations in a row.
+  __m128i previous2 = _mm_alignr_epi8(input, state->previous, 14);
+  __m128i previous3 = _mm_alignr_epi8(input, state->previous, 13);
+  __m128i third = _mm_subs_epu8(previous2, _mm_set1_epi8((char)(0xe0 - 0x80)));
+  __m128i fourth = _mm_subs_epu8(previous3, _mm_set1_epi8((char)(0xf0 - 0x80)));
+  __m128i must_continue = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8((char)0x80));
+
+  state->error = _mm_or_si128(state->error, _mm_xor_si128(must_continue, special));
+
+  // A sequence that starts in the last three bytes continues in the next
+  // block.
+  const __m128i limit = _mm_setr_epi8(
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    (char)(0xf0 - 1), (char)(0xe0 - 1), (char)(0xc0 - 1));
+  state->incomplete = _mm_subs_epu8(input, limit);
+  state->previous = input;
+}
+
+__attribute__((target("ssse3")))
+int utf8_validate_ssse3(const unsigned char *data, size_t length) {
+  utf8_state_t state = { _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128() };
+  size_t index = 0;
+
+  while (index + 64 <= length) {
+    __m128i blocks[4];
+    for (int idx = 0; idx < 4; idx++) {
+      blocks[idx] = _mm_loadu_si128((const __m128i *)(data + index + idx * 16));
+    }
+    __m128i any = _mm_or_si128(_mm_or_si128(blocks[0], blocks[1]), _mm_or_si128(blocks[2], blocks[3]));
+
+    if (_mm_movemask_epi8(any) == 0) {
+      // ASCII only: valid unless a sequence was cut off before it. The rest
+      // of the run is skipped by the plain ASCII loop.
+      state.error = _mm_or_si128(state.error, state.incomplete);
+      state.incomplete = _mm_setzero_si128();
+      index = utf8_skip_ascii(data, index + 64, length);
+      state.previous = _mm_loadu_si128((const __m128i *)(data + index - 16));
+    } else {
+      for (int idx = 0; idx < 4; idx++) {
+        utf8_check_block(&state, blocks[idx]);
+      }
+      index += 64;
+    }
+  }
+
+  // The tail is padded with ASCII, which also flags a truncated sequence.
+  while (index < length) {
+    unsigned char tail[16] = { 0 };
+    size_t count = length - index < 16 ? length - index : 16;
+    memcpy(tail, data + index, count);
+    utf8_check_block(&state, _mm_loadu_si128((const __m128i *)tail));
+    index += count;
+  }
+
+  state.error = _mm_or_si128(state.error, state.incomplete);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(state.error, _mm_setzero_si128())) == 0xffff;
+}
+
+#endif
+
+int utf8_validate(const char *input, size_t length) {
+#if defined(UTF8_SSSE3)
+  if (__builtin_cpu_supports("ssse3")) {
+    return utf8_validate_ssse3((const unsigned char *)input, length);
+  }
+#endif
+
+  return utf8_validate_scalar((const unsigned char *)input, length);
+}
@@ -0,0 +1,21 @@
+#ifndef _H_UTF8
+#define _H_UTF8
+
+#include <stddef.h>
+
+/**
+ * Checks that the data is well-formed UTF-8 (RFC 3629): no overlong
+ * encodings, no surrogates, nothing above U+10FFFF and no truncated
+ * sequences. On x86 CPUs with SSSE3, multibyte text is checked 16 bytes at
+ * a time with table lookups and ASCII runs 64 bytes at a time. Otherwise the
+ * check is scalar, with ASCII runs skipped 32 bytes at a time with SSE2 or
+ * 8 bytes at a time without it.
+ *
+ * @param input: Data to validate.
+ * @param length: Length of the data.
+ *
+ * @return 1 if the data is valid UTF-8, 0 otherwise.
+ */
+int utf8_validate(const char *input, size_t length);
+
+#endif